@@ -1078,6 +1078,14 @@
 #       undef __GENERATE_ATOMIC_FUNCS
 #       undef __GENERATE_ATOMIC_FUNC
 #   elif GCC_PREREQ(1) /* GCC legacy __sync builtins */
+#       if defined(__i386__) || defined(__x86_64__)
+            /* x86 only lets loads pass earlier stores, and xchg fences */
+#           define __SYNC_HAS_XCHG 1
+#           define __SYNC_FENCE() __asm__ __volatile__("" ::: "memory")
+#       else
+#           define __SYNC_HAS_XCHG 0
+#           define __SYNC_FENCE() __sync_synchronize()
+#       endif
 #       define __GENERATE_ATOMIC_FUNC(x, y) \
             static_inline x ##_t atomic_fetch_ ##y ##_ ##x ( \
                 atomic_ ##x volatile* a, \
@@ -1089,22 +1097,43 @@
             static_inline x ##_t atomic_load_ ##x ( \
                 atomic_ ##x volatile const* a \
             ) { \
-                return __sync_fetch_and_add(&a->val, 0); \
+                x ##_t result; \
+                if (sizeof(x ##_t) > sizeof(void*)) /* a plain load tears */ \
+                    return __sync_val_compare_and_swap( \
+                        (x ##_t volatile*)&a->val, 0, 0 \
+                    ); \
+                result = a->val; \
+                __SYNC_FENCE(); \
+                return result; \
             } \
-            static_inline void atomic_store_ ##x ( \
+            static_inline x ##_t atomic_exchange_ ##x ( \
                 atomic_ ##x volatile* a, \
                 x ##_t b \
             ) { \
-                __sync_lock_test_and_set(&a->val, b); \
-                __sync_lock_release(&a->val); \
-            } \ \
-            static_inline x ##_t atomic_exchange_ ##x ( \
+                x ##_t result, previous; \
+                if (__SYNC_HAS_XCHG && sizeof(x ##_t) <= sizeof(void*)) { \
+                    __SYNC_FENCE(); \
+                    return __sync_lock_test_and_set(&a->val, b); \
+                } \
+                result = a->val; \
+                while ((previous = __sync_val_compare_and_swap( \
+                    &a->val, result, b \
+                )) != result) { \
+                    result = previous; \
+                } \
+                return result; \
+            } \
+            static_inline void atomic_store_ ##x ( \
                 atomic_ ##x volatile* a, \
                 x ##_t b \
             ) { \
-                x ##_t result = __sync_lock_test_and_set(&a->val, b); \
-                __sync_lock_release(&a->val); \
-                return result; \
+                if (__SYNC_HAS_XCHG || sizeof(x ##_t) > sizeof(void*)) { \
+                    (void)atomic_exchange_ ##x(a, b); \
+                } else { \
+                    __sync_synchronize(); \
+                    a->val = b; \
+                    __sync_synchronize(); \
+                } \
             } \
             static_inline bool atomic_compare_exchange_strong_ ##x ( \
                 atomic_ ##x volatile* a, \
@@ -1112,9 +1141,11 @@
                 x ##_t c \
             ) { \
                 x ##_t result = __sync_val_compare_and_swap(&a->val, *b, c); \
-                if (result != c) \
+                if (result != *b) { \
                     *b = result; \
-                return result != c; \
+                    return false; \
+                } \
+                return true; \
             } \
             static_inline bool atomic_compare_exchange_weak_ ##x ( \
                 atomic_ ##x volatile* a, \
@@ -1160,6 +1191,8 @@
 #       pragma GCC diagnostic pop
 #       undef __GENERATE_ATOMIC_FUNCS
 #       undef __GENERATE_ATOMIC_FUNC
+#       undef __SYNC_FENCE
+#       undef __SYNC_HAS_XCHG
 #   elif MSVC_PREREQ(1500) /* MSVC 2008+ atomic intrinsics */
 #       include <intrin.h>
 #       define __MSVC_ATOMIC_SUFFIX_int8    8
@@ -1178,13 +1211,25 @@
 #       define __MSVC_ATOMIC_TYPE_uint32 int
 #       define __MSVC_ATOMIC_TYPE_int64  __int64
 #       define __MSVC_ATOMIC_TYPE_uint64 __int64
+#       if defined(__aarch64__)
+#           define __MSVC_ATOMIC_LOAD_FENCE() __dmb(_ARM64_BARRIER_ISH)
+#       elif defined(__arm__)
+#           define __MSVC_ATOMIC_LOAD_FENCE() __dmb(_ARM_BARRIER_ISH)
+#       else /* x86 stores already go through xchg */
+#           define __MSVC_ATOMIC_LOAD_FENCE() _ReadWriteBarrier()
+#       endif
 #       define __GENERATE_ATOMIC_FUNCS(x) \
             static_inline x ##_t atomic_load_ ##x ( \
                 atomic_ ##x volatile const* a \
             ) { \
-                return (x ##_t)CONCATENATE(_InterlockedCompareExchange, \
-                    __MSVC_ATOMIC_SUFFIX_ ##x \
-                )((__MSVC_ATOMIC_TYPE_ ##x volatile*)&a->val, 0, 0); \
+                x ##_t result; \
+                if (sizeof(x ##_t) > sizeof(void*)) /* a plain load tears */ \
+                    return (x ##_t)CONCATENATE(_InterlockedCompareExchange, \
+                        __MSVC_ATOMIC_SUFFIX_ ##x \
+                    )((__MSVC_ATOMIC_TYPE_ ##x volatile*)&a->val, 0, 0); \
+                result = a->val; \
+                __MSVC_ATOMIC_LOAD_FENCE(); \
+                return result; \
             } \
             static_inline void atomic_store_ ##x ( \
                 atomic_ ##x volatile* a, \
@@ -1218,9 +1263,11 @@
                     (__MSVC_ATOMIC_TYPE_ ##x)*b, \
                     (__MSVC_ATOMIC_TYPE_ ##x)c \
                 ); \
-                if (result != c) \
+                if (result != *b) { \
                     *b = result; \
-                return result != c; \
+                    return false; \
+                } \
+                return true; \
             } \
             static_inline bool atomic_compare_exchange_weak_ ##x ( \
                 atomic_ ##x volatile* a, \
@@ -1350,6 +1397,7 @@
 #       undef __MSVC_ATOMIC_TYPE_uint32
 #       undef __MSVC_ATOMIC_TYPE_int64
 #       undef __MSVC_ATOMIC_TYPE_uint64
+#       undef __MSVC_ATOMIC_LOAD_FENCE
 #   elif defined(__WATCOMC__) && defined(__i386__) /* Watcom x86 assembly */
         /* TODO: finish Watcom x86 auxilaries */
 #       define __GENERATE_ATOMIC_FUNCDEFS(x) \
@@ -1364,7 +1412,7 @@
         extern _inline void atomic_fence(void);
 
 #       pragma aux atomic_fence = \
-            "" \
+            "lock or dword ptr [esp], 0" \
             parm [] \
             modify exact [];
 #       pragma aux atomic_exchange_int8 = \
@@ -1398,38 +1446,32 @@
             value [eax] \
             modify exact [eax];
 #       pragma aux atomic_load_int8 = \
-            "mfence" \
-            "mov [ecx], al" \
+            "mov al, [ecx]" \
             parm [ecx] \
             value [al] \
             modify exact [al];
 #       pragma aux atomic_load_uint8 = \
-            "mfence" \
-            "mov [ecx], al" \
+            "mov al, [ecx]" \
             parm [ecx] \
             value [al] \
             modify exact [al];
 #       pragma aux atomic_load_int16 = \
-            "mfence" \
-            "mov [ecx], ax" \
+            "mov ax, [ecx]" \
             parm [ecx] \
             value [ax] \
             modify exact [ax];
 #       pragma aux atomic_load_uint16 = \
-            "mfence" \
-            "mov [ecx], ax" \
+            "mov ax, [ecx]" \
             parm [ecx] \
             value [ax] \
             modify exact [ax];
 #       pragma aux atomic_load_int32 = \
-            "mfence" \
-            "mov [ecx], eax" \
+            "mov eax, [ecx]" \
             parm [ecx] \
             value [eax] \
             modify exact [eax];
 #       pragma aux atomic_load_uint32 = \
-            "mfence" \
-            "mov [ecx], eax" \
+            "mov eax, [ecx]" \
             parm [ecx] \
             value [eax] \
             modify exact [eax];
@@ -1651,6 +1693,386 @@
 #   undef __GENERATE_ATOMIC_FUNC
 #   undef __ATOMIC_USING_STD
 #endif
+/* == ATOMIC MIN/MAX ======================================================== */
+
+/**
+ * @fn x_t atomic_fetch_min_X(atomic_X volatile* a, x_t b)
+ * @brief Atomically replaces a value with the smaller of it and @e b.
+ * 
+ * @param[in,out] a Pointer to an atomic integer.
+ * @param[in]     b An integer to compare with @e a.
+ * 
+ * @note One instruction on ARMv8.1 with LSE. Elsewhere a CAS loop which
+ *       doesn't write, or take the cache line exclusive, when @e a is
+ *       already smaller.
+ * 
+ * @returns The previous value of @e a.
+ */
+/**
+ * @fn x_t atomic_fetch_max_X(atomic_X volatile* a, x_t b)
+ * @brief Atomically replaces a value with the larger of it and @e b.
+ * 
+ * @param[in,out] a Pointer to an atomic integer.
+ * @param[in]     b An integer to compare with @e a.
+ * 
+ * @note As with @c atomic_fetch_min_X, nothing is written when @e a is
+ *       already larger.
+ * 
+ * @returns The previous value of @e a.
+ */
+#if defined(__aarch64__) && defined(__ARM_FEATURE_ATOMICS) && \
+    (GCC_PREREQ(1) || CLANG_PREREQ(1))
+#   define __ATOMIC_LSE_int8(op)   "lds" op "alb %w2, %w0, %1"
+#   define __ATOMIC_LSE_uint8(op)  "ldu" op "alb %w2, %w0, %1"
+#   define __ATOMIC_LSE_int16(op)  "lds" op "alh %w2, %w0, %1"
+#   define __ATOMIC_LSE_uint16(op) "ldu" op "alh %w2, %w0, %1"
+#   define __ATOMIC_LSE_int32(op)  "lds" op "al %w2, %w0, %1"
+#   define __ATOMIC_LSE_uint32(op) "ldu" op "al %w2, %w0, %1"
+#   define __ATOMIC_LSE_int64(op)  "lds" op "al %x2, %x0, %1"
+#   define __ATOMIC_LSE_uint64(op) "ldu" op "al %x2, %x0, %1"
+#   define __GENERATE_ATOMIC_FUNC(x, y) \
+        static_inline x ##_t atomic_fetch_ ##y ##_ ##x ( \
+            atomic_ ##x volatile* a, \
+            x ##_t b \
+        ) { \
+            x ##_t result; \
+            __asm__ __volatile__( \
+                __ATOMIC_LSE_ ##x(#y) \
+                : "=&r"(result), "+Q"(*(x ##_t volatile*)a) \
+                : "r"(b) \
+                : "memory" \
+            ); \
+            return result; \
+        }
+#else
+#   define __GENERATE_ATOMIC_FUNC(x, y) \
+        static_inline x ##_t atomic_fetch_ ##y ##_ ##x ( \
+            atomic_ ##x volatile* a, \
+            x ##_t b \
+        ) { \
+            x ##_t result = atomic_load_ ##x(a); \
+            while (__ATOMIC_ ##y(b, result) && \
+                !atomic_compare_exchange_weak_ ##x(a, &result, b) \
+            ); \
+            return result; \
+        }
+#   define __ATOMIC_min(b, current) ((b) < (current))
+#   define __ATOMIC_max(b, current) ((b) > (current))
+#endif
+#define __GENERATE_ATOMIC_FUNCS(x) \
+    __GENERATE_ATOMIC_FUNC(x, min) \
+    __GENERATE_ATOMIC_FUNC(x, max)
+__MACRODEFS_ENUMERATE_ATOMICS(__GENERATE_ATOMIC_FUNCS)
+#undef __GENERATE_ATOMIC_FUNCS
+#undef __GENERATE_ATOMIC_FUNC
+#undef __ATOMIC_max
+#undef __ATOMIC_min
+#undef __ATOMIC_LSE_int8
+#undef __ATOMIC_LSE_uint8
+#undef __ATOMIC_LSE_int16
+#undef __ATOMIC_LSE_uint16
+#undef __ATOMIC_LSE_int32
+#undef __ATOMIC_LSE_uint32
+#undef __ATOMIC_LSE_int64
+#undef __ATOMIC_LSE_uint64
 #undef __MACRODEFS_ENUMERATE_ATOMICS
 
+/* == ATOMIC FLOATING POINT ================================================= */
+
+/**
+ * @typedef atomic_float
+ * @brief An atomic single-precision float, stored in an @c atomic_uint32.
+ * 
+ * @note Operations are suffixed with @c _float (or @c _double for
+ *       @c atomic_double) and take and return floating-point values.
+ *       Compare-exchange compares bit patterns, so it matches @c NaN with
+ *       itself but tells @c -0.0 and @c 0.0 apart.
+ * 
+ * @note @c fetch_add and @c fetch_sub are CAS loops; no mainstream CPU
+ *       has a floating-point atomic add.
+ */
+#define __GENERATE_ATOMIC_FLOAT(x, y) \
+    typedef atomic_ ##y atomic_ ##x; \
+    static_inline x atomic_load_ ##x ( \
+        atomic_ ##x volatile const* a \
+    ) { \
+        union { x f; y ##_t u; } value; \
+        value.u = atomic_load_ ##y(a); \
+        return value.f; \
+    } \
+    static_inline void atomic_store_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x b \
+    ) { \
+        union { x f; y ##_t u; } value; \
+        value.f = b; \
+        atomic_store_ ##y(a, value.u); \
+    } \
+    static_inline x atomic_exchange_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x b \
+    ) { \
+        union { x f; y ##_t u; } value; \
+        value.f = b; \
+        value.u = atomic_exchange_ ##y(a, value.u); \
+        return value.f; \
+    } \
+    static_inline bool atomic_compare_exchange_strong_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x* b, \
+        x c \
+    ) { \
+        union { x f; y ##_t u; } expected, desired; \
+        bool result; \
+        expected.f = *b; \
+        desired.f = c; \
+        result = atomic_compare_exchange_strong_ ##y( \
+            a, &expected.u, desired.u \
+        ); \
+        *b = expected.f; \
+        return result; \
+    } \
+    static_inline bool atomic_compare_exchange_weak_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x* b, \
+        x c \
+    ) { \
+        union { x f; y ##_t u; } expected, desired; \
+        bool result; \
+        expected.f = *b; \
+        desired.f = c; \
+        result = atomic_compare_exchange_weak_ ##y( \
+            a, &expected.u, desired.u \
+        ); \
+        *b = expected.f; \
+        return result; \
+    } \
+    static_inline x atomic_fetch_add_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x b \
+    ) { \
+        union { x f; y ##_t u; } current, next; \
+        current.u = atomic_load_ ##y(a); \
+        do { \
+            next.f = current.f + b; \
+        } while (!atomic_compare_exchange_weak_ ##y(a, &current.u, next.u)); \
+        return current.f; \
+    } \
+    static_inline x atomic_fetch_sub_ ##x ( \
+        atomic_ ##x volatile* a, \
+        x b \
+    ) { \
+        return atomic_fetch_add_ ##x(a, -b); \
+    }
+__GENERATE_ATOMIC_FLOAT(float, uint32)
+#ifdef _INT64_DEFINED
+    __GENERATE_ATOMIC_FLOAT(double, uint64)
+#endif
+#undef __GENERATE_ATOMIC_FLOAT
+
+/* == SPIN-WAIT HINTS ======================================================= */
+
+#if MSVC_PREREQ(1) && !CLANG_PREREQ(1)
+#   include <intrin.h>
+#elif defined(__WATCOMC__) && defined(__i386__)
+    extern void __atomics_pause(void);
+#   pragma aux __atomics_pause = "db 0f3h,90h"
+#endif
+
+/**
+ * @brief Tells the CPU that the caller is busy-waiting on memory.
+ * 
+ * @note Frees execution resources for a sibling hyperthread and avoids the
+ *       pipeline flush on leaving the loop. A no-op where the architecture
+ *       has no such hint.
+ */
+static_force_inline void cpu_relax(void) {
+#if MSVC_PREREQ(1) && !CLANG_PREREQ(1)
+#   if defined(__i386__) || defined(__x86_64__)
+    _mm_pause();
+#   elif defined(__arm__) || defined(__aarch64__)
+    __yield();
+#   endif
+#elif GCC_PREREQ(1) || CLANG_PREREQ(1)
+#   if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__("pause" ::: "memory");
+#   elif defined(__aarch64__) || (defined(__arm__) && __ARM_ARCH >= 7)
+    __asm__ __volatile__("yield" ::: "memory");
+#   elif defined(__powerpc__) || defined(__powerpc64__)
+    __asm__ __volatile__("or 27,27,27" ::: "memory");
+#   endif
+#elif defined(__WATCOMC__) && defined(__i386__)
+    __atomics_pause();
+#endif
+}
+
+/* == POINTER-SIZED ATOMICS ================================================= */
+
+/**
+ * @typedef atomic_uintptr
+ * @brief An atomic unsigned integer wide enough to hold a pointer.
+ * 
+ * @note Operations are suffixed with @c _uintptr like the other sized types,
+ *       and take and return @c uintptr_t values.
+ */
+#if WORD_SIZE == 64 && defined(_INT64_DEFINED)
+#   define __ATOMIC_UINTPTR(name) name ##_uint64
+    typedef atomic_uint64 atomic_uintptr;
+#else
+#   define __ATOMIC_UINTPTR(name) name ##_uint32
+    typedef atomic_uint32 atomic_uintptr;
+#endif
+static_inline uintptr_t atomic_load_uintptr(
+    atomic_uintptr volatile const* a
+) {
+    return (uintptr_t)__ATOMIC_UINTPTR(atomic_load)(a);
+}
+static_inline void atomic_store_uintptr(
+    atomic_uintptr volatile* a,
+    uintptr_t b
+) {
+    __ATOMIC_UINTPTR(atomic_store)(a, b);
+}
+static_inline bool atomic_compare_exchange_strong_uintptr(
+    atomic_uintptr volatile* a,
+    uintptr_t* b,
+    uintptr_t c
+) {
+    bool result;
+#if WORD_SIZE == 64 && defined(_INT64_DEFINED)
+    uint64_t expected = *b;
+#else
+    uint32_t expected = (uint32_t)*b;
+#endif
+    result = __ATOMIC_UINTPTR(atomic_compare_exchange_strong)(a, &expected, c);
+    *b = (uintptr_t)expected;
+    return result;
+}
+static_inline bool atomic_compare_exchange_weak_uintptr(
+    atomic_uintptr volatile* a,
+    uintptr_t* b,
+    uintptr_t c
+) {
+    bool result;
+#if WORD_SIZE == 64 && defined(_INT64_DEFINED)
+    uint64_t expected = *b;
+#else
+    uint32_t expected = (uint32_t)*b;
+#endif
+    result = __ATOMIC_UINTPTR(atomic_compare_exchange_weak)(a, &expected, c);
+    *b = (uintptr_t)expected;
+    return result;
+}
+#define __GENERATE_ATOMIC_FUNC(y) \
+    static_inline uintptr_t y ##_uintptr( \
+        atomic_uintptr volatile* a, \
+        uintptr_t b \
+    ) { \
+        return (uintptr_t)__ATOMIC_UINTPTR(y)(a, b); \
+    }
+__GENERATE_ATOMIC_FUNC(atomic_exchange)
+__GENERATE_ATOMIC_FUNC(atomic_fetch_add)
+__GENERATE_ATOMIC_FUNC(atomic_fetch_sub)
+__GENERATE_ATOMIC_FUNC(atomic_fetch_and)
+__GENERATE_ATOMIC_FUNC(atomic_fetch_or)
+__GENERATE_ATOMIC_FUNC(atomic_fetch_xor)
+#undef __GENERATE_ATOMIC_FUNC
+#undef __ATOMIC_UINTPTR
+
+/* == ATOMIC BITMAPS ======================================================== */
+
+#ifdef _INT64_DEFINED
+
+/**
+ * @brief Atomically sets a bit in a bitmap of 64-bit words.
+ * 
+ * @param[in,out] map Pointer to the first word of the bitmap.
+ * @param[in]     bit Index of the bit to set.
+ * 
+ * @returns The previous value of the bit.
+ */
+static_inline bool atomic_bitmap_test_and_set(
+    atomic_uint64 volatile* map,
+    size_t bit
+) {
+    uint64_t mask = UINT64_C(1) << (bit & 63);
+    return (atomic_fetch_or_uint64(&map[bit >> 6], mask) & mask) != 0;
+}
+
+/**
+ * @brief Atomically clears a bit in a bitmap of 64-bit words.
+ * 
+ * @param[in,out] map Pointer to the first word of the bitmap.
+ * @param[in]     bit Index of the bit to clear.
+ * 
+ * @returns The previous value of the bit.
+ */
+static_inline bool atomic_bitmap_clear(
+    atomic_uint64 volatile* map,
+    size_t bit
+) {
+    uint64_t mask = UINT64_C(1) << (bit & 63);
+    return (atomic_fetch_and_uint64(&map[bit >> 6], ~mask) & mask) != 0;
+}
+
+/**
+ * @brief Atomically reads a bit in a bitmap of 64-bit words.
+ * 
+ * @param[in] map Pointer to the first word of the bitmap.
+ * @param[in] bit Index of the bit to read.
+ * 
+ * @returns The value of the bit.
+ */
+static_inline bool atomic_bitmap_test(
+    atomic_uint64 volatile const* map,
+    size_t bit
+) {
+    return (atomic_load_uint64(&map[bit >> 6]) >> (bit & 63)) & 1;
+}
+
+/**
+ * @brief Atomically finds a clear bit in a bitmap and sets it.
+ * 
+ * @param[in,out] map  Pointer to the first word of the bitmap.
+ * @param[in]     bits The number of bits in the bitmap.
+ * @param[in,out] bit  On input, a hint of where to start looking, such as
+ *                     the last bit this thread claimed; on output, the bit
+ *                     which was claimed.
+ * 
+ * @note Words are searched from the hint's onwards, wrapping around, and a
+ *       free bit is picked with a single count of trailing ones. Keeping a
+ *       separate hint per thread spreads threads over different words, so a
+ *       claim usually costs one load and one compare-exchange.
+ * 
+ * @returns @c true if a bit was claimed; @c false if every bit was set.
+ */
+static_inline bool atomic_bitmap_claim(
+    atomic_uint64 volatile* map,
+    size_t bits,
+    size_t *const bit
+) {
+    size_t words = (bits + 63) >> 6;
+    size_t i = *bit < bits ? *bit >> 6 : 0, n;
+
+    for (n = 0; n < words; ++n, i = i + 1 < words ? i + 1 : 0) {
+        uint64_t valid = i + 1 == words && (bits & 63) ?
+            (UINT64_C(1) << (bits & 63)) - 1 : ~UINT64_C(0);
+        uint64_t word = atomic_load_uint64(&map[i]);
+
+        while (~word & valid) {
+            unsigned j = CTZ64(~word & valid);
+            if (atomic_compare_exchange_weak_uint64(
+                &map[i], &word, word | (UINT64_C(1) << j)
+            )) {
+                *bit = i << 6 | j;
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+#endif /* _INT64_DEFINED */
+
 #endif /* ATOMICS_H_ */
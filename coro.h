@@ -56,6 +56,16 @@ typedef struct Coro_Fiber Coro_Fiber;
  */
 typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
 
+/**
+ * @brief Lifecycle state of a stackful coroutine.
+ */
+typedef enum Coro_FiberStatus {
+    FIBER_READY,  /**< Armed with a function that hasn't been entered yet. */
+    FIBER_ACTIVE, /**< Running or suspended inside its function. */
+    FIBER_DONE,   /**< Function returned; result is available. */
+    FIBER_FAILED  /**< A lazy fiber suspended but no stack could be had. */
+} Coro_FiberStatus;
+
 #ifdef _USES_WINFIBERS
 #   undef _USES_WINFIBERS
 #endif
@@ -80,6 +90,8 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
         void* back;
         Coro_Function fn;
         uintptr_t up;
+        Coro_FiberStatus status;
+        int result;
     };
 
 #   define __FIBER_INIT(coro, start, param, stksz) return !!( \
@@ -99,22 +111,59 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
         SwitchToFiber((coro)->handle); \
     }
 #   define __FIBER_SUSPEND(coro) { SwitchToFiber((coro)->back); }
+#   define __FIBER_SWITCH_TO(from, to) { \
+        (to)->back = (from)->back; \
+        SwitchToFiber((to)->handle); \
+    }
 #   define __FIBER_STARTDECL STDCALL
 #   define __FIBER_STARTPARAMS (void* p)
 #   define __FIBER_GETPTR Coro_Fiber* coro = (Coro_Fiber*)p;
 #   define _USES_WINFIBERS
 #elif GCC_PREREQ(30000) && !defined(CORO_NO_ASM) /* gcc assembly */
+#   define __FIBER_ASM_NAME(name) STRINGIFY(__USER_LABEL_PREFIX__) #name
+#   ifdef __ELF__
+#       define __FIBER_ASM_LOCAL(name) \
+            ".weak " __FIBER_ASM_NAME(name) "\n" \
+            ".hidden " __FIBER_ASM_NAME(name) "\n" \
+            ".type " __FIBER_ASM_NAME(name) ", %function\n"
+#       define __FIBER_ASM_SIZE(name) \
+            ".size " __FIBER_ASM_NAME(name) ", .-" __FIBER_ASM_NAME(name) "\n"
+#   elif defined(__MACH__)
+#       define __FIBER_ASM_LOCAL(name) \
+            ".weak_definition " __FIBER_ASM_NAME(name) "\n" \
+            ".private_extern " __FIBER_ASM_NAME(name) "\n"
+#       define __FIBER_ASM_SIZE(name)
+#   else
+#       define __FIBER_ASM_LOCAL(name) ".weak " __FIBER_ASM_NAME(name) "\n"
+#       define __FIBER_ASM_SIZE(name)
+#   endif
 #   ifdef __i386__
+        void __fiber_entry(void) __asm__(__FIBER_ASM_NAME(__fiber_entry));
+
+        __asm__ (
+            ".text\n"
+            ".p2align 4\n"
+            __FIBER_ASM_LOCAL(__fiber_entry)
+            __FIBER_ASM_NAME(__fiber_entry) ":\n"
+            "  .cfi_startproc\n"
+            "  .cfi_undefined eip\n"
+            "  xorl %ebp, %ebp\n"
+            "  calll *4(%esp)\n"
+            "  ud2\n"
+            "  .cfi_endproc\n"
+            __FIBER_ASM_SIZE(__fiber_entry)
+        );
+
 #       ifdef __PIC__
             typedef struct { uintptr_t eip, esp, ebp, ebx; } _Coro_Context;
 
             static_force_inline void __fiber_switch(
-                _Coro_Context *const __restrict from,
-                _Coro_Context *const __restrict to
+                _Coro_Context *__restrict from,
+                _Coro_Context *__restrict to
             ) {
                 __asm__ __volatile__ (
                     "call 1f\n"
-                    "1:\ttpopl %%eax\n\t"
+                    "1:\tpopl %%eax\n\t"
                     "addl $(2f-1b),%%eax\n\t"
                     "movl %%eax, (%0)\n\t"
                     "movl %%esp, 4(%0)\n\t"
@@ -135,12 +184,13 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
                     , "cc"
                 );
             }
+#           define __FIBER_CTX_EXTRA(ctx) (ctx).ebx = 0;
 #       else
             typedef struct { uintptr_t eip, esp, ebp; } _Coro_Context;
 
             static_force_inline void __fiber_switch(
-                _Coro_Context *const __restrict from,
-                _Coro_Context *const __restrict to
+                _Coro_Context *__restrict from,
+                _Coro_Context *__restrict to
             ) {
                 __asm__ __volatile__ (
                     "movl $1f, (%0)\n\t"
@@ -160,27 +210,48 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
                     , "cc"
                 );
             }
+#           define __FIBER_CTX_EXTRA(ctx)
 #       endif
 
+#       define __FIBER_STKADJUST 4
 #       define __FIBER_CTX_INIT(coro, ctx, func, stack, param) do { \
-            (ctx).eip = (uintptr_t)__extension__(void*)(func); \
+            (ctx).eip = (uintptr_t)__extension__(void*)__fiber_entry; \
             (ctx).esp = (uintptr_t)(stack); \
             (ctx).ebp = 0; \
-            (stack)[0] = 0xdeadc0de; \
-            (coro)->param = (param); \
+            __FIBER_CTX_EXTRA(ctx) \
+            (stack)[0] = (uintptr_t)(param); \
+            (stack)[1] = (uintptr_t)__extension__(void*)(func); \
+            (stack)[2] = 0xdeadc0de; \
         } while (0)
-#       define __FIBER_SWITCH(from, to) __fiber_switch(from, to)
-#       define __FIBER_STATE_HEAD uintptr_t param;
+#       define __FIBER_SWITCH(from, to) __fiber_switch(from, to);
 #       ifdef _NO_CORO_IMPL
 #           undef _NO_CORO_IMPL
 #       endif
 #   elif defined(__x86_64__)
-        static void __fiber_entry(void) {
-            __asm__ __volatile__ ( "\tmovq %r13, %rdi\n\tjmpq *%r12\n" );
-        }
+        void __fiber_entry(void) __asm__(__FIBER_ASM_NAME(__fiber_entry));
+
+        __asm__ (
+            ".text\n"
+            ".p2align 4\n"
+            __FIBER_ASM_LOCAL(__fiber_entry)
+            __FIBER_ASM_NAME(__fiber_entry) ":\n"
+            "  .cfi_startproc\n"
+            "  .cfi_undefined rip\n"
+            "  xorl %ebp, %ebp\n"
+#       ifdef _WIN32
+            "  movq %r13, %rcx\n"
+            "  subq $32, %rsp\n"
+#       else
+            "  movq %r13, %rdi\n"
+#       endif
+            "  callq *%r12\n"
+            "  ud2\n"
+            "  .cfi_endproc\n"
+            __FIBER_ASM_SIZE(__fiber_entry)
+        );
 
-        typedef ALIGN_TO(16) struct {
-            uint64_t parts[2];
+        typedef struct {
+            ALIGN_TO(16) uint64_t parts[2];
         } _Coro_R128;
 
         typedef struct {
@@ -192,8 +263,8 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
         } _Coro_Context;
 
         static_force_inline void __fiber_switch(
-            _Coro_Context *const __restrict from,
-            _Coro_Context *const __restrict to
+            _Coro_Context *__restrict from,
+            _Coro_Context *__restrict to
         ) {
             __asm__ __volatile__ (
                 "leaq 1f(%%rip), %%rax\n\t"
@@ -261,18 +332,19 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
             );
         }
 
+#       define __FIBER_STKADJUST 2
 #       define __FIBER_CTX_INIT(coro, ctx, func, stack, param) do { \
             (ctx).rip = (uintptr_t)__extension__(void*)__fiber_entry; \
             (ctx).rsp = (uintptr_t)(stack); \
             (ctx).rbp = 0; \
             (ctx).rbx = 0; \
-            (ctx).r12 = __extension__(void*)(func); \
-            (ctx).r13 = (param); \
+            (ctx).r12 = (uintptr_t)__extension__(void*)(func); \
+            (ctx).r13 = (uintptr_t)(param); \
             (ctx).r14 = 0; \
             (ctx).r15 = 0; \
             __FIBER_CTX_EXTRA(ctx) \
             (stack)[0] = 0xdeadc0dedeadc0de; \
-        while (0)
+        } while (0)
 #       define __FIBER_SWITCH(from, to) __fiber_switch(from, to);
 #       ifdef _NO_CORO_IMPL
 #           undef _NO_CORO_IMPL
@@ -524,50 +596,51 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
             uintptr_t r4, r5, r6, r7, r8, r9, r10, r11, lr, sp;
         } _Coro_Context;
 
-        void __fiber_start(void);
-        int __fiber_switch(
+        void __fiber_entry(void) __asm__(__FIBER_ASM_NAME(__fiber_entry));
+        void __fiber_switch(
             _Coro_Context *const __restrict from,
             _Coro_Context *const __restrict to
-        );
+        ) __asm__(__FIBER_ASM_NAME(__fiber_switch));
 
         __asm__ (
             ".text\n"
-            ".globl __fiber_switch\n"
-            ".type __fiber_switch #function\n"
-            ".hidden __fiber_switch\n"
-            "__fiber_switch:\n"
-#       ifndef __SOFTFP
+            __FIBER_ASM_LOCAL(__fiber_switch)
+            __FIBER_ASM_NAME(__fiber_switch) ":\n"
+#       ifndef __SOFTFP__
             "  vstmia r0!, {d8-d15}\n"
 #       endif
             "  stmia r0, {r4-r11, lr}\n"
             "  str sp, [r0, #9*4]\n"
-#       ifndef __SOFTFP
+#       ifndef __SOFTFP__
             "  vldmia r1!, {d8-d15}\n"
 #       endif
             "  ldr sp, [r1, #9*4]\n"
             "  ldmia r1, {r4-r11, pc}\n"
-            ".size __fiber_switch, .-__fiber_switch\n"
+            __FIBER_ASM_SIZE(__fiber_switch)
         );
 
         __asm__ (
             ".text\n"
-            ".globl __fiber_start\n"
-            ".type __fiber_start #function\n"
-            ".hidden __fiber_start\n"
-            "__fiber_start:\n"
+            __FIBER_ASM_LOCAL(__fiber_entry)
+            __FIBER_ASM_NAME(__fiber_entry) ":\n"
+            "  .fnstart\n"
+            "  .cantunwind\n"
+            "  .cfi_startproc\n"
+            "  .cfi_undefined lr\n"
+            "  mov fp, #0\n"
             "  mov r0, r4\n"
-            "  mov ip, r5\n"
-            "  mov lr, r6\n"
-            "  bx ip\n"
-            ".size __fiber_start, .-__fiber_start\n"
+            "  blx r5\n"
+            "  udf #0\n"
+            "  .cfi_endproc\n"
+            "  .fnend\n"
+            __FIBER_ASM_SIZE(__fiber_entry)
         );
 
 #       define __FIBER_STKADJUST 0
 #       define __FIBER_CTX_INIT(coro, ctx, func, stack, param) do { \
-            (ctx).r4 = (param); \
+            (ctx).r4 = (uintptr_t)(param); \
             (ctx).r5 = (uintptr_t)__extension__(void*)(func); \
-            (ctx).r6 = 0xdeadc0de; \
-            (ctx).lr = (uintptr_t)__extension__(void*)__fiber_start; \
+            (ctx).lr = (uintptr_t)__extension__(void*)__fiber_entry; \
             (ctx).sp = (uintptr_t)(stack); \
         } while (0)
 #       define __FIBER_SWITCH(from, to) __fiber_switch(from, to);
@@ -580,17 +653,16 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
             uintptr_t x30, sp, lr, d8, d9, d10, d11, d12, d13, d14, d15;
         } _Coro_Context;
 
-        int __fiber_switch(
+        void __fiber_entry(void) __asm__(__FIBER_ASM_NAME(__fiber_entry));
+        void __fiber_switch(
             _Coro_Context *const __restrict from,
             _Coro_Context *const __restrict to
-        );
+        ) __asm__(__FIBER_ASM_NAME(__fiber_switch));
 
         __asm__(
             ".text\n"
-            ".globl coco_switch\n"
-            ".type coco_switch #function\n"
-            ".hidden coco_switch\n"
-            "coco_switch:\n"
+            __FIBER_ASM_LOCAL(__fiber_switch)
+            __FIBER_ASM_NAME(__fiber_switch) ":\n"
             "  mov x10, sp\n"
             "  mov x11, x30\n"
             "  stp x19, x20, [x0, #(0*16)]\n"
@@ -617,28 +689,30 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
             "  ldp x10, x11, [x1, #(6*16)]\n"
             "  mov sp, x10\n"
             "  br x11\n"
-            ".size coco_switch, .-coco_switch\n"
+            __FIBER_ASM_SIZE(__fiber_switch)
         );
 
         __asm__(
             ".text\n"
-            ".globl coco_wrap_main\n"
-            ".type coco_wrap_main #function\n"
-            ".hidden coco_wrap_main\n"
-            "coco_wrap_main:\n"
+            __FIBER_ASM_LOCAL(__fiber_entry)
+            __FIBER_ASM_NAME(__fiber_entry) ":\n"
+            "  .cfi_startproc\n"
+            "  .cfi_undefined x30\n"
+            "  mov x29, #0\n"
             "  mov x0, x19\n"
-            "  mov x30, x21\n"
-            "  br x20\n"
-            ".size coco_wrap_main, .-coco_wrap_main\n"
+            "  blr x20\n"
+            "  brk #0\n"
+            "  .cfi_endproc\n"
+            __FIBER_ASM_SIZE(__fiber_entry)
         );
-        
+
 #       define __FIBER_STKADJUST 0
 #       define __FIBER_CTX_INIT(coro, ctx, func, stack, param) do { \
-            (ctx).x19 = (param); \
+            (ctx).x19 = (uintptr_t)(param); \
             (ctx).x20 = (uintptr_t)__extension__(void*)(func); \
-            (ctx).x21 = 0xdeadc0dedeadc0de; \
+            (ctx).x29 = 0; \
             (ctx).sp = (uintptr_t)(stack) & ~15; \
-            (ctx).lr = (uintptr_t)__extension__(void*)__fiber_start; \
+            (ctx).lr = (uintptr_t)__extension__(void*)__fiber_entry; \
         } while (0)
 #       define __FIBER_SWITCH(from, to) __fiber_switch(from, to);
 #       ifdef _NO_CORO_IMPL
@@ -860,13 +934,17 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
 #   endif
 #elif !defined(_USES_WINFIBERS)
 #   define __FIBER_SETUP(coro, nf, start) { \
-        uintptr_t* stkptr = \
-            ((uintptr_t*)(coro)->alloc_ptr) - __FIBER_STKADJUST \
-        ; \
+        uintptr_t* stkptr = __ALIGNED_END( \
+            (coro)->alloc_ptr, (coro)->alloc_size, uintptr_t \
+        ) - __FIBER_STKADJUST; \
         __FIBER_CTX_INIT(coro, (coro)->ctx, start, stkptr, nf); \
     }
 #   define __FIBER_RESUME(coro)  { __FIBER_SWITCH(&(coro)->back, &(coro)->ctx) }
 #   define __FIBER_SUSPEND(coro) { __FIBER_SWITCH(&(coro)->ctx, &(coro)->back) }
+#   define __FIBER_SWITCH_TO(from, to) { \
+        (to)->back = (from)->back; \
+        __FIBER_SWITCH(&(from)->ctx, &(to)->ctx) \
+    }
 #endif
 
 #ifndef __FIBER_STKADJUST
@@ -900,7 +978,7 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
 #   if defined(CORO_USE_VALGRIND) || __has_include(<valgrind/valgrind.h>)
 #       include <valgrind/valgrind.h>
 #       define __FIBER_VREG(coro, p, s) \
-            (coro)->vid = VALGRIND_STACK_REGISTER((p), (p) + (sz));
+            (coro)->vid = VALGRIND_STACK_REGISTER((p), (char*)(p) + (s));
 #       define __FIBER_VUNREG(coro) VALGRIND_STACK_DEREGISTER((coro)->vid);
 #       define __FIBER_VID unsigned int vid;
 #   else
@@ -909,14 +987,140 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
 #       define __FIBER_VID
 #   endif
 
+#   ifdef CORO_USE_REGISTRY
+#       include "atomics.h"
+
+        /**
+         * @brief A live fiber stack, as published in @c coro_fiber_registry.
+         */
+        typedef struct Coro_StackRecord {
+            struct Coro_StackRecord* next, * prev;
+            uintptr_t stack_lo, stack_hi;
+            Coro_Fiber* fiber;
+        } Coro_StackRecord;
+
+        /**
+         * @brief List of every live fiber stack in the process.
+         * 
+         * @note Profilers and debuggers outside the process locate this via
+         *       the @c coro_fiber_registry symbol. @e generation is odd while
+         *       the list is being modified; a reader should retry its walk
+         *       whenever it reads an odd value or the value changes mid-walk.
+         */
+        typedef struct {
+            uint32_t version;
+            atomic_uint32 generation;
+            atomic_uint32 lock;
+            Coro_StackRecord* head;
+        } Coro_StackRegistry;
+
+#       define CORO_REGISTRY_VERSION 1
+
+#       ifdef CORO_IMPLEMENTATION
+            Coro_StackRegistry coro_fiber_registry = { CORO_REGISTRY_VERSION };
+#       else
+            extern Coro_StackRegistry coro_fiber_registry;
+#       endif
+
+        static_inline void __fiber_registry_lock(void) {
+            while (atomic_exchange_uint32(&coro_fiber_registry.lock, 1));
+            atomic_fetch_add_uint32(&coro_fiber_registry.generation, 1);
+        }
+        static_inline void __fiber_registry_unlock(void) {
+            atomic_fetch_add_uint32(&coro_fiber_registry.generation, 1);
+            atomic_store_uint32(&coro_fiber_registry.lock, 0);
+        }
+
+        static_inline void __fiber_registry_add(
+            Coro_StackRecord *const rec,
+            Coro_Fiber *const coro,
+            void *const p,
+            size_t s
+        ) {
+            rec->stack_lo = (uintptr_t)p;
+            rec->stack_hi = (uintptr_t)p + s;
+            rec->fiber = coro;
+            rec->prev = NULL;
+
+            __fiber_registry_lock();
+            if ((rec->next = coro_fiber_registry.head))
+                rec->next->prev = rec;
+            coro_fiber_registry.head = rec;
+            __fiber_registry_unlock();
+        }
+        static_inline void __fiber_registry_remove(
+            Coro_StackRecord *const rec
+        ) {
+            __fiber_registry_lock();
+            if (rec->prev)
+                rec->prev->next = rec->next;
+            else
+                coro_fiber_registry.head = rec->next;
+            if (rec->next)
+                rec->next->prev = rec->prev;
+            __fiber_registry_unlock();
+        }
+
+#       define __FIBER_RREG(coro, p, s) \
+            __fiber_registry_add(&(coro)->rec, (coro), (p), (s));
+#       define __FIBER_RUNREG(coro) __fiber_registry_remove(&(coro)->rec);
+#       define __FIBER_RID Coro_StackRecord rec;
+#   else
+#       define __FIBER_RREG(coro, p, s)
+#       define __FIBER_RUNREG(coro)
+#       define __FIBER_RID
+#   endif
+
+#   include <setjmp.h>
+#   if defined(__unix__) || defined(__APPLE__)
+#       define __FIBER_LAZY_SETJMP(env) _setjmp(env)
+#       define __FIBER_LAZY_LONGJMP(env) _longjmp(env, 1)
+#   else
+#       define __FIBER_LAZY_SETJMP(env) setjmp(env)
+#       define __FIBER_LAZY_LONGJMP(env) longjmp(env, 1)
+#   endif
+
+#   ifndef FIBER_HUGE_PAGE_SIZE
+#       define FIBER_HUGE_PAGE_SIZE 2097152
+#   endif /* !FIBER_HUGE_PAGE_SIZE */
+
+    /**
+     * @brief Describes how the memory behind a stack arena is backed.
+     */
+    enum {
+        FIBER_ARENA_HUGETLB = 1, /**< Reserved huge pages via MAP_HUGETLB. */
+        FIBER_ARENA_THP     = 2  /**< Transparent huge pages via madvise. */
+    };
+
+    /**
+     * @brief A single mapping carved into equally sized fiber stacks.
+     * 
+     * @note Packing many stacks into huge pages keeps switching between
+     *       thousands of fibers from thrashing the TLB. An arena isn't
+     *       thread-safe; keep one per thread.
+     */
+    typedef struct Coro_StackArena {
+        char* base;
+        size_t map_size;
+        size_t slot_size, slot_count;
+        size_t hint;
+        uint64_t* used;
+        int flags;
+    } Coro_StackArena;
+
     struct Coro_Fiber {
         __FIBER_STATE_HEAD
         __FIBER_VID
+        __FIBER_RID
         _Coro_Context ctx, back;
         Coro_Function fn;
         uintptr_t up;
+        Coro_FiberStatus status;
+        int result;
         void* alloc_ptr;
         size_t alloc_size;
+        Coro_StackArena* arena;
+        jmp_buf* env;
     };
 
 #   ifdef __unix__
@@ -928,6 +1132,9 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
 #       ifndef MAP_PRIVATE
 #           define MAP_PRIVATE 0
 #       endif
+#       if !defined(MAP_ANON) && defined(MAP_ANONYMOUS)
+#           define MAP_ANON MAP_ANONYMOUS
+#       endif
 
 #       define __ALIGNED_END(p, s, t) \
             ((t*)(((char*)0) + ((((char*)(p)-(char*)0)+(s)-sizeof(t)) & -16)))
@@ -946,37 +1153,204 @@ typedef int (CDECL* Coro_Function)(Coro_Fiber *const, uintptr_t);
                 0, 0 \
             )) == MAP_FAILED) \
                 return false; \
-            __FIBER_VREG(coro, (coro)->alloc_ptr, stksz) \
+            (coro)->arena = NULL; \
+            __FIBER_VREG(coro, (coro)->alloc_ptr, (coro)->alloc_size) \
+            __FIBER_RREG(coro, (coro)->alloc_ptr, (coro)->alloc_size) \
             __FIBER_SETUP(coro, param, start) \
             return true; \
         } while (0)
-#       define __FIBER_DESTROY(coro) { \
+#       define __FIBER_DESTROY(coro) { if ((coro)->alloc_ptr) { \
+            void* stack = (coro)->alloc_ptr; \
+            __FIBER_RUNREG(coro) \
             __FIBER_VUNREG(coro) \
-            munmap((coro)->alloc_ptr, (coro)->alloc_size); \
             (coro)->alloc_ptr = NULL; \
-        }
+            if ((coro)->arena) \
+                __fiber_arena_release((coro)->arena, stack); \
+            else \
+                munmap(stack, (coro)->alloc_size); \
+        } }
 #   else
 #       define __ALIGNED_END(p, s, t) \
             ((t*)(((char*)0) + ((((char*)(p)-(char*)0)+(s)-sizeof(t)) & -16)))
 #       define __FIBER_INIT(coro, start, param, stksz) do { \
             if (!((coro)->alloc_ptr = malloc(stksz))) \
                 return false; \
-            __FIBER_VREG(coro, (coro)->alloc_ptr, stksz) \
             coro->alloc_size = (stksz); \
+            (coro)->arena = NULL; \
+            __FIBER_VREG(coro, (coro)->alloc_ptr, (coro)->alloc_size) \
+            __FIBER_RREG(coro, (coro)->alloc_ptr, (coro)->alloc_size) \
             __FIBER_SETUP(coro, param, start) \
             return true; \
         } while (0)
-#       define __FIBER_DESTROY(coro) { \
+#       define __FIBER_DESTROY(coro) { if ((coro)->alloc_ptr) { \
+            void* stack = (coro)->alloc_ptr; \
+            __FIBER_RUNREG(coro) \
             __FIBER_VUNREG(coro) \
-            free((coro)->alloc_ptr); \
             (coro)->alloc_ptr = NULL; \
+            if ((coro)->arena) \
+                __fiber_arena_release((coro)->arena, stack); \
+            else \
+                free(stack); \
+        } }
+#   endif
+
+    /**
+     * @brief Reserves memory for a fixed number of fiber stacks.
+     * 
+     * @param[out] arena      The arena to initialize.
+     * @param[in]  slot_count The maximum number of stacks handed out at once.
+     * @param[in]  stack_size The size of each stack, or 0 for the default.
+     * 
+     * @note Explicitly reserved huge pages are tried first, then transparent
+     *       huge pages, then plain pages. @e flags records which one stuck.
+     *       Stacks carved from an arena have no guard pages.
+     * 
+     * @returns @c true on success; @c false on failure.
+     */
+    static_inline bool fiber_arena_init(
+        Coro_StackArena *const arena,
+        size_t slot_count,
+        size_t stack_size
+    ) {
+        size_t page, words;
+
+#   ifdef __unix__
+        char* p;
+        size_t lead;
+
+        page = (size_t)sysconf(_SC_PAGESIZE);
+#   else
+        page = 4096;
+#   endif
+
+        if (!stack_size)
+            stack_size = FIBER_DEFAULT_STACK_SIZE;
+        else if (stack_size < FIBER_MIN_STACK_SIZE)
+            stack_size = FIBER_MIN_STACK_SIZE;
+        stack_size = (stack_size + page - 1) & ~(page - 1);
+        if (!slot_count || slot_count >
+            ((size_t)-1 - 2 * (size_t)FIBER_HUGE_PAGE_SIZE) / stack_size)
+            return false;
+
+        arena->slot_size = stack_size;
+        arena->slot_count = slot_count;
+        arena->hint = 0;
+        arena->flags = 0;
+        arena->map_size = slot_count * stack_size + FIBER_HUGE_PAGE_SIZE - 1;
+        arena->map_size &= ~((size_t)FIBER_HUGE_PAGE_SIZE - 1);
+
+        words = (slot_count + 63) >> 6;
+        if (!(arena->used = (uint64_t*)calloc(words, sizeof(uint64_t))))
+            return false;
+        if (slot_count & 63)
+            arena->used[words - 1] = ~UINT64_C(0) << (slot_count & 63);
+
+#   ifdef __unix__
+        p = (char*)MAP_FAILED;
+#       ifdef MAP_HUGETLB
+        p = (char*)mmap(
+            NULL, arena->map_size,
+            PROT_READ | PROT_WRITE,
+            MAP_ANON | MAP_PRIVATE | MAP_HUGETLB,
+            -1, 0
+        );
+        if (p != (char*)MAP_FAILED) {
+            arena->base = p;
+            arena->flags = FIBER_ARENA_HUGETLB;
+            return true;
+        }
+#       endif
+
+        /* MAP_STACK is left out: newer kernels refuse THP for such mappings */
+        if ((p = (char*)mmap(
+            NULL, arena->map_size + FIBER_HUGE_PAGE_SIZE,
+            PROT_READ | PROT_WRITE,
+            MAP_ANON | MAP_PRIVATE,
+            -1, 0
+        )) == (char*)MAP_FAILED) {
+            free(arena->used);
+            return false;
+        }
+
+        lead = (size_t)-(uintptr_t)p & (FIBER_HUGE_PAGE_SIZE - 1);
+        if (lead)
+            munmap(p, lead);
+        munmap(p + lead + arena->map_size, FIBER_HUGE_PAGE_SIZE - lead);
+        arena->base = p + lead;
+
+#       ifdef MADV_HUGEPAGE
+        if (!madvise(arena->base, arena->map_size, MADV_HUGEPAGE))
+            arena->flags = FIBER_ARENA_THP;
+#       endif
+#   else
+        if (!(arena->base = (char*)malloc(arena->map_size))) {
+            free(arena->used);
+            return false;
         }
 #   endif
+
+        return true;
+    }
+
+    /**
+     * @brief Releases an arena's memory.
+     * 
+     * @param[in,out] arena The arena to free. Every fiber initialized from it
+     *                      must already be destroyed.
+     */
+    static_inline void fiber_arena_destroy(
+        Coro_StackArena *const arena
+    ) {
+#   ifdef __unix__
+        munmap(arena->base, arena->map_size);
+#   else
+        free(arena->base);
+#   endif
+        free(arena->used);
+        arena->base = NULL;
+        arena->used = NULL;
+    }
+
+    static_inline void* __fiber_arena_acquire(
+        Coro_StackArena *const arena
+    ) {
+        size_t words = (arena->slot_count + 63) >> 6;
+        size_t i = arena->hint, n;
+        unsigned bit;
+
+        for (n = 0; n < words; ++n, i = i + 1 < words ? i + 1 : 0) {
+            if (arena->used[i] == ~UINT64_C(0))
+                continue;
+
+            bit = CTZ64(~arena->used[i]);
+            arena->used[i] |= UINT64_C(1) << bit;
+            arena->hint = i;
+            return arena->base + (i << 6 | bit) * arena->slot_size;
+        }
+
+        return NULL;
+    }
+
+    static_inline void __fiber_arena_release(
+        Coro_StackArena *const arena,
+        void* stack
+    ) {
+        size_t slot = (size_t)((char*)stack - arena->base) / arena->slot_size;
+
+        /* recently freed stacks are still hot in cache and TLB, reuse first */
+        arena->used[slot >> 6] &= ~(UINT64_C(1) << (slot & 63));
+        arena->hint = slot >> 6;
+    }
 #endif
 
 static void __FIBER_STARTDECL __fiber_start __FIBER_STARTPARAMS {
     __FIBER_STARTUNUSED __FIBER_GETPTR
-    exit((*coro->fn)(coro, coro->up));
+    for (;;) {
+        coro->status = FIBER_ACTIVE;
+        coro->result = (*coro->fn)(coro, coro->up);
+        coro->status = FIBER_DONE;
+        __FIBER_SUSPEND(coro)
+    }
 }
 
 static_force_inline bool fiber_init(
@@ -996,6 +1370,8 @@ static_force_inline bool fiber_init(
 
     coro->fn = func;
     coro->up = param;
+    coro->status = FIBER_READY;
+    coro->result = 0;
     __FIBER_INIT(
         coro,
         __fiber_start,
@@ -1004,17 +1380,483 @@ static_force_inline bool fiber_init(
     );
 }
 
+#ifdef __FIBER_SETUP
+/**
+ * @brief Initializes a fiber on a stack taken from an arena.
+ * 
+ * @param[out]    coro  The fiber to initialize.
+ * @param[in,out] arena The arena to take a stack from.
+ * @param[in]     func  The function to run when the fiber is first resumed.
+ * @param[in]     param A user parameter to pass to @e func.
+ * 
+ * @note @c fiber_destroy hands the stack back to @e arena.
+ * 
+ * @returns @c true on success; @c false if @e arena has no free stacks.
+ */
+static_inline bool fiber_init_arena(
+    Coro_Fiber *const coro,
+    Coro_StackArena *const arena,
+    Coro_Function func,
+    uintptr_t param
+) {
+    if (!(coro->alloc_ptr = __fiber_arena_acquire(arena)))
+        return false;
+
+    coro->alloc_size = arena->slot_size;
+    coro->arena = arena;
+    coro->fn = func;
+    coro->up = param;
+    coro->status = FIBER_READY;
+    coro->result = 0;
+    __FIBER_VREG(coro, coro->alloc_ptr, coro->alloc_size)
+    __FIBER_RREG(coro, coro->alloc_ptr, coro->alloc_size)
+    __FIBER_SETUP(coro, (uintptr_t)coro, __fiber_start)
+    return true;
+}
+
+/**
+ * @brief Creates a fiber which lives at the top of its own stack.
+ * 
+ * @param[in] func       The function to run when the fiber is first resumed.
+ * @param[in] param      A user parameter to pass to @e func.
+ * @param[in] stack_size The size of the stack, or 0 for the default.
+ * @param[in] extra      Bytes of user storage to reserve directly after the
+ *                       returned fiber, also taken from the stack mapping.
+ * 
+ * @note The fiber's address never changes, so a handle to it can be moved
+ *       around freely. @c fiber_destroy releases the fiber itself.
+ * 
+ * @returns The new fiber on success; @c NULL on failure.
+ */
+static_inline Coro_Fiber* fiber_create(
+    Coro_Function func,
+    uintptr_t param,
+    size_t stack_size,
+    size_t extra
+) {
+    Coro_Fiber tmp, * coro;
+    size_t head = (sizeof(Coro_Fiber) + extra + 63) & ~(size_t)63;
+
+    if (!stack_size)
+        stack_size = FIBER_DEFAULT_STACK_SIZE;
+    if (!fiber_init(&tmp, func, param, stack_size + head))
+        return NULL;
+
+    __FIBER_RUNREG(&tmp)
+    __FIBER_VUNREG(&tmp)
+    coro = (Coro_Fiber*)((
+        (uintptr_t)tmp.alloc_ptr + tmp.alloc_size - head
+    ) & ~(uintptr_t)63);
+    *coro = tmp;
+
+    /* set the stack up again below the fiber, pointing at its new address */
+    coro->alloc_size = (size_t)((char*)coro - (char*)coro->alloc_ptr);
+    __FIBER_VREG(coro, coro->alloc_ptr, coro->alloc_size)
+    __FIBER_RREG(coro, coro->alloc_ptr, coro->alloc_size)
+    __FIBER_SETUP(coro, (uintptr_t)coro, __fiber_start)
+    coro->alloc_size = tmp.alloc_size;
+    return coro;
+}
+
+/**
+ * @brief Initializes a fiber which only takes a stack once it suspends.
+ * 
+ * @param[out]    coro  The fiber to initialize.
+ * @param[in,out] arena The arena to take a stack from if one is needed.
+ * @param[in]     func  The function to run when the fiber is first resumed.
+ * @param[in]     param A user parameter to pass to @e func.
+ * 
+ * @note The first resume calls @e func directly on the resumer's stack, so a
+ *       fiber which runs to completion costs little more than a function
+ *       call. If @e func suspends instead, its frames are discarded and it is
+ *       started over on a stack from @e arena. Everything @e func does before
+ *       its first @c fiber_suspend must therefore be safe to repeat, and must
+ *       not rely on C++ destructors running.
+ * @note If @e arena has no free stack when one is needed, the fiber gets
+ *       one of @e arena's slot size from @c fiber_init's allocator instead.
+ *       If that fails too, its status becomes @c FIBER_FAILED and further
+ *       resumes return at once rather than repeat its work.
+ * @note Until its first suspend the fiber must not call @c fiber_switch_to.
+ * 
+ * @returns Always @c true.
+ */
+static_inline bool fiber_init_lazy(
+    Coro_Fiber *const coro,
+    Coro_StackArena *const arena,
+    Coro_Function func,
+    uintptr_t param
+) {
+    coro->alloc_ptr = NULL;
+    coro->alloc_size = 0;
+    coro->arena = arena;
+    coro->env = NULL;
+    coro->fn = func;
+    coro->up = param;
+    coro->status = FIBER_READY;
+    coro->result = 0;
+    return true;
+}
+
+static no_inline void __fiber_lazy_resume(
+    Coro_Fiber *const coro
+) {
+    jmp_buf env;
+
+    if (!__FIBER_LAZY_SETJMP(env)) {
+        coro->env = &env;
+        coro->status = FIBER_ACTIVE;
+        coro->result = (*coro->fn)(coro, coro->up);
+        coro->status = FIBER_DONE;
+        coro->env = NULL;
+        return;
+    }
+
+    /* the function suspended; start it over on a stack of its own */
+    coro->env = NULL;
+    coro->status = FIBER_READY;
+    if ((coro->alloc_ptr = __fiber_arena_acquire(coro->arena))) {
+        coro->alloc_size = coro->arena->slot_size;
+        __FIBER_VREG(coro, coro->alloc_ptr, coro->alloc_size)
+        __FIBER_RREG(coro, coro->alloc_ptr, coro->alloc_size)
+        __FIBER_SETUP(coro, (uintptr_t)coro, __fiber_start)
+    } else if (!fiber_init(coro, coro->fn, coro->up, coro->arena->slot_size)) {
+        coro->alloc_ptr = NULL;
+        coro->status = FIBER_FAILED;
+        return;
+    }
+    __FIBER_RESUME(coro)
+}
+#endif /* __FIBER_SETUP */
+
 static_force_inline void fiber_destroy(
     Coro_Fiber *const coro
 ) __FIBER_DESTROY(coro)
 
 static_force_inline void fiber_resume(
     Coro_Fiber *const coro
-) __FIBER_RESUME(coro)
+) {
+    if UNLIKELY(coro->status >= FIBER_DONE)
+        return;
+
+#ifdef __FIBER_SETUP
+    if UNLIKELY(!coro->alloc_ptr) {
+        __fiber_lazy_resume(coro);
+        return;
+    }
+#endif /* __FIBER_SETUP */
+    __FIBER_RESUME(coro)
+}
 
 static_force_inline void fiber_suspend(
     Coro_Fiber *const coro
-) __FIBER_SUSPEND(coro)
+) {
+#ifdef __FIBER_SETUP
+    if UNLIKELY(!coro->alloc_ptr)
+        __FIBER_LAZY_LONGJMP(*coro->env);
+#endif /* __FIBER_SETUP */
+    __FIBER_SUSPEND(coro)
+}
+
+/**
+ * @brief Transfers control directly from the running fiber to another.
+ * 
+ * @param[in,out] from The currently running fiber.
+ * @param[in,out] to   A suspended fiber to run in place of @e from.
+ * 
+ * @note @e to inherits the return context of @e from, so its next call to
+ *       @c fiber_suspend goes back to whoever last resumed @e from. This lets
+ *       a chain of fibers hand off to each other with one switch per hop
+ *       instead of two through the resumer.
+ * @note @e from stays suspended until it is resumed or switched to again.
+ */
+static_force_inline void fiber_switch_to(
+    Coro_Fiber *const from,
+    Coro_Fiber *const to
+) __FIBER_SWITCH_TO(from, to)
+
+/**
+ * @brief Checks whether a fiber's function has returned.
+ * 
+ * @param[in] coro The fiber to query.
+ * 
+ * @returns @c true if the fiber is done; @c false otherwise.
+ */
+static_force_inline bool fiber_done(
+    Coro_Fiber const *const coro
+) {
+    return coro->status == FIBER_DONE;
+}
+
+/**
+ * @brief Resumes a fiber until its function returns.
+ * 
+ * @param[in,out] coro The fiber to run to completion.
+ * 
+ * @returns The value returned by the fiber's function; 0 if the fiber's
+ *          status became @c FIBER_FAILED instead.
+ */
+static_inline int fiber_join(
+    Coro_Fiber *const coro
+) {
+    while (coro->status < FIBER_DONE)
+        fiber_resume(coro);
+    return coro->status == FIBER_DONE ? coro->result : 0;
+}
+
+/**
+ * @brief Re-arms a fiber and its stack to run a new function.
+ * 
+ * @param[in,out] coro  A fiber which is done or hasn't been resumed yet.
+ * @param[in]     func  The function to run on the next resume.
+ * @param[in]     param A user parameter to pass to @e func.
+ * 
+ * @note The stack allocated by @c fiber_init is kept, so a pool of finished
+ *       fibers can be recycled without any allocation.
+ * 
+ * @returns @c true on success; @c false if @e coro is still inside its
+ *          previous function.
+ */
+static_inline bool fiber_reset(
+    Coro_Fiber *const coro,
+    Coro_Function func,
+    uintptr_t param
+) {
+    if (coro->status == FIBER_ACTIVE)
+        return false;
+
+    coro->fn = func;
+    coro->up = param;
+    coro->status = FIBER_READY;
+    coro->result = 0;
+    return true;
+}
+
+#if CPP_PREREQ(201103L) && defined(__FIBER_SETUP)
+#   include <cstddef>
+#   include <new>
+#   include <type_traits>
+#   include <utility>
+
+namespace coro {
+    /**
+     * @brief The channel a @c coro::fiber body yields values through.
+     * 
+     * @tparam T The type of value yielded, or @c void to yield nothing.
+     */
+    template <typename T>
+    class yielder {
+    public:
+        /**
+         * @brief Hands a value to the resumer and suspends the fiber.
+         * 
+         * @param[in] value The value to yield. The resumer sees it in place
+         *                  until the fiber is resumed again.
+         */
+        void operator()(T& value) {
+            this->value = &value;
+            fiber_suspend(this->coro);
+        }
+        void operator()(T&& value) {
+            this->value = &value;
+            fiber_suspend(this->coro);
+        }
+
+    private:
+        template <typename> friend class fiber;
+        Coro_Fiber* coro;
+        T* value;
+    };
+
+    template <>
+    class yielder<void> {
+    public:
+        /**
+         * @brief Suspends the fiber.
+         */
+        void operator()() {
+            fiber_suspend(this->coro);
+        }
+
+    private:
+        template <typename> friend class fiber;
+        Coro_Fiber* coro;
+    };
+
+    /**
+     * @brief A move-only fiber running a C++ callable.
+     * 
+     * @tparam T The type of value the callable yields, or @c void.
+     * 
+     * @note The callable and its yielder are stored at the top of the fiber's
+     *       own stack alongside the @c Coro_Fiber, so spawning a fiber makes
+     *       no heap allocations. The callable takes a @c coro::yielder<T>&
+     *       and must not throw.
+     */
+    template <typename T = void>
+    class fiber {
+    public:
+        /**
+         * @brief The result of @c resume: a pointer to the yielded value, or a
+         *        @c bool when @e T is @c void. Either is false once the
+         *        callable has returned.
+         */
+        typedef typename std::conditional<
+            std::is_void<T>::value, bool, T*
+        >::type resume_type;
+
+        fiber() NO_EXCEPT : coro(nullptr), chan(nullptr), destroy(nullptr) {}
+
+        /**
+         * @brief Creates a fiber to run a callable.
+         * 
+         * @param[in] fn         The callable to run on the first resume.
+         * @param[in] stack_size The size of the stack, or 0 for the default.
+         * 
+         * @note On allocation failure the fiber is empty; test it with
+         *       @c operator bool. If copying or moving @e fn throws, the
+         *       stack is freed before the exception propagates.
+         */
+        template <typename F, typename = typename std::enable_if<
+            !std::is_same<typename std::decay<F>::type, fiber>::value
+        >::type>
+        explicit fiber(F&& fn, size_t stack_size = 0) :
+            coro(nullptr), chan(nullptr), destroy(nullptr)
+        {
+            typedef state<typename std::decay<F>::type> S;
+            S* st;
+
+            this->coro = fiber_create(
+                &S::entry, 0, stack_size, sizeof(S) + alignof(S) - 1
+            );
+            if (!this->coro)
+                return;
+
+#   ifdef __cpp_exceptions
+            try {
+                st = new (state_ptr<S>(this->coro)) S(std::forward<F>(fn));
+            } catch (...) {
+                fiber_destroy(this->coro);
+                this->coro = nullptr;
+                throw;
+            }
+#   else
+            st = new (state_ptr<S>(this->coro)) S(std::forward<F>(fn));
+#   endif
+            st->yield.coro = this->coro;
+            this->coro->up = reinterpret_cast<uintptr_t>(st);
+            this->chan = &st->yield;
+            this->destroy = &S::destroy;
+        }
+
+        fiber(fiber&& other) NO_EXCEPT :
+            coro(other.coro), chan(other.chan), destroy(other.destroy)
+        {
+            other.coro = nullptr;
+        }
+
+        fiber& operator=(fiber&& other) NO_EXCEPT {
+            if (this != &other) {
+                this->reset();
+                this->coro = other.coro;
+                this->chan = other.chan;
+                this->destroy = other.destroy;
+                other.coro = nullptr;
+            }
+            return *this;
+        }
+
+        fiber(fiber const&) = delete;
+        fiber& operator=(fiber const&) = delete;
+
+        /**
+         * @note Destroying a suspended fiber discards its frames without
+         *       running their destructors; only the callable is destroyed.
+         */
+        ~fiber() {
+            this->reset();
+        }
+
+        /**
+         * @brief Runs the fiber until it yields or its callable returns.
+         * 
+         * @returns The yielded value; false if the callable has returned or
+         *          the fiber is empty.
+         */
+        resume_type resume() {
+            if (!this->coro)
+                return resume_type();
+            fiber_resume(this->coro);
+            return this->result(std::is_void<T>());
+        }
+
+        /**
+         * @brief Checks whether the fiber's callable has returned.
+         */
+        bool done() const NO_EXCEPT {
+            return !this->coro || fiber_done(this->coro);
+        }
+
+        explicit operator bool() const NO_EXCEPT {
+            return this->coro != nullptr;
+        }
+
+        /**
+         * @brief The underlying C fiber, for use with the rest of coro.h.
+         */
+        Coro_Fiber* native_handle() const NO_EXCEPT {
+            return this->coro;
+        }
+
+    private:
+        template <typename F>
+        struct state {
+            yielder<T> yield;
+            F fn;
+
+            template <typename G>
+            explicit state(G&& fn) : fn(std::forward<G>(fn)) {}
+
+            static int CDECL entry(Coro_Fiber* coro, uintptr_t up) NO_EXCEPT {
+                state* st = reinterpret_cast<state*>(up);
+                (void)coro;
+                st->fn(st->yield);
+                return 0;
+            }
+
+            static void destroy(Coro_Fiber* coro) NO_EXCEPT {
+                reinterpret_cast<state*>(coro->up)->~state();
+            }
+        };
+
+        template <typename S>
+        static void* state_ptr(Coro_Fiber* coro) NO_EXCEPT {
+            uintptr_t p = reinterpret_cast<uintptr_t>(coro + 1);
+            return reinterpret_cast<void*>(
+                (p + alignof(S) - 1) & ~static_cast<uintptr_t>(alignof(S) - 1)
+            );
+        }
+
+        void reset() NO_EXCEPT {
+            if (this->coro) {
+                this->destroy(this->coro);
+                fiber_destroy(this->coro);
+                this->coro = nullptr;
+            }
+        }
+
+        T* result(std::false_type) const NO_EXCEPT {
+            return fiber_done(this->coro) ? nullptr : this->chan->value;
+        }
+        bool result(std::true_type) const NO_EXCEPT {
+            return !fiber_done(this->coro);
+        }
+
+        Coro_Fiber* coro;
+        yielder<T>* chan;
+        void (*destroy)(Coro_Fiber*);
+    };
+}
+#endif /* CPP_PREREQ(201103L) && __FIBER_SETUP */
 
 #define __fiber_entry
 #define __fiber_switch
@@ -1022,10 +1864,14 @@ static_force_inline void fiber_suspend(
 #undef __FIBER_VREG
 #undef __FIBER_VUNREG
 #undef __FIBER_VID
+#undef __FIBER_RREG
+#undef __FIBER_RUNREG
+#undef __FIBER_RID
 #undef __FIBER_INIT
 #undef __FIBER_DESTROY
 #undef __FIBER_RESUME
 #undef __FIBER_SUSPEND
+#undef __FIBER_SWITCH_TO
 #undef __FIBER_GETPTR
 #undef __FIBER_STARTDECL
 #undef __FIBER_STARTDECL
@@ -1048,9 +1894,19 @@ static_force_inline void fiber_suspend(
 #ifdef __FIBER_CTX_EXTRA
 #   undef __FIBER_CTX_EXTRA
 #endif /* __FIBER_CTX_EXTRA */
+#ifdef __FIBER_ASM_NAME
+#   undef __FIBER_ASM_NAME
+#   undef __FIBER_ASM_LOCAL
+#   undef __FIBER_ASM_SIZE
+#endif /* __FIBER_ASM_NAME */
 #ifdef __FIBER_CTX_INIT
 #   undef __FIBER_CTX_INIT
 #endif /* __FIBER_CTX_INIT */
+#ifdef __FIBER_SETUP
+#   undef __FIBER_SETUP
+#   undef __FIBER_LAZY_SETJMP
+#   undef __FIBER_LAZY_LONGJMP
+#endif /* __FIBER_SETUP */
 
 #endif /* CORO_NO_FIBERS */
 
@@ -1097,7 +1953,7 @@ static_force_inline void fiber_suspend(
         _CORO_DEFINE1(name) params
 #   define _CORO_DEFINE3(name, params, body) \
         _CORO_DEFINE1(name) params { \
-            CORO_START(name) body CORO_END; \
+            CORO_BEGIN(name) body CORO_END(); \
         }
 #   define _CORO_DEFINE11(name) _CoroRet ##name name
 #   define _CORO_DEFINE01(name, params) _CoroRet ##name name params
@@ -1106,40 +1962,182 @@ static_force_inline void fiber_suspend(
 #endif
 #ifdef _GNUC_VA_ARGS
 #   define _CORO_DEFINE00(name, params, args...) \
-        _CORO_DEFINE01(name, params) { CORO_BEGIN(name) args CORO_END; }
+        _CORO_DEFINE01(name, params) { CORO_BEGIN(name) args CORO_END(); }
 #   define CORO_DEFINE(args...) \
         _CORO_INVOKE(_PASTE3,(_CORO_DEFINE, \
-            VARGEMPTY _TUPTAIL(args), \
-            VARGEMPTY _TUPTAIL _TUPTAIL(args) \
+            VARGEMPTY(_TUPTAIL(args)), \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(args))) \
         ))(args)
 #elif !defined _NO_VA_ARGS
 #   define _CORO_DEFINE00(name, params, ...) \
-        _CORO_DEFINE01(name, params) { CORO_BEGIN(name) __VA_ARGS__ CORO_END; }
+        _CORO_DEFINE01(name, params) { \
+            CORO_BEGIN(name) __VA_ARGS__ CORO_END(); \
+        }
 #   define CORO_DEFINE(...) \
         _CORO_INVOKE(_PASTE3,(_CORO_DEFINE, \
-            VARGEMPTY _TUPTAIL(__VA_ARGS__), \
-            VARGEMPTY _TUPTAIL _TUPTAIL(__VA_ARGS__) \
+            VARGEMPTY(_TUPTAIL(__VA_ARGS__)), \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(__VA_ARGS__))) \
         ))(__VA_ARGS__)
 #endif
 
-#define CORO_BEGIN(name) do \
-    switch (coro[0] & UINT32_C(0xffffffff)) { \
-        enum { _lineoff = __LINE__ }; \
-        Coro_Stack *const coro_next = &coro[_CORO_FRAME_SIZE_ ##name]; \
-        _CoroFrame ##name *const frame = (_CoroFrame ##name*)&coro[1]; \
-        (void)frame; (void)coro_next; \
-    default: do
+/*
+ * With CORO_USE_COMPUTED_GOTO and GNU C, a suspended coroutine's state holds
+ * the offset of its resume label from an anchor label, tagged with a set low
+ * bit so it's never zero, and resuming is a single indirect jump. Being an
+ * offset rather than an address, it stays valid across processes for
+ * position-independent code. GCC never inlines a function containing a
+ * computed goto, so this is opt-in; by default the state is a line number
+ * dispatched through a switch.
+ */
+#if GCC_PREREQ(1) && defined(CORO_USE_COMPUTED_GOTO)
+#   define _CORO_DISPATCH { \
+        _coro_anchor: \
+        if (coro[0] & UINT32_C(0xffffffff)) __extension__ ({ \
+            goto *(void*)((char*)&&_coro_anchor + \
+                ((int32_t)(uint32_t)coro[0] >> 1) \
+            ); \
+        }); \
+        do
+#   define _CORO_SETSTATE_(id, line) coro[0] = (Coro_Stack)(( \
+        (uint32_t)(__extension__ \
+            ((char*)&&CONCATENATE(_coro_resume_, id) - (char*)&&_coro_anchor) \
+        ) << 1) | 1)
+#   define _CORO_LABEL(id, line) CONCATENATE(_coro_resume_, id)
+#   define _CORO_DISPATCH_KIND 1
+#else
+#   define _CORO_DISPATCH \
+        switch (coro[0] & UINT32_C(0xffffffff)) { \
+        default: do
+#   define _CORO_SETSTATE_(id, line) coro[0] = (Coro_Stack)(line)
+#   define _CORO_LABEL(id, line) case line
+#   define _CORO_DISPATCH_KIND 0
+#endif
+
+#ifdef CORO_USE_STATS
+#   include <stdio.h>
+#   include <string.h>
+
+#   ifndef CORO_STATS_LINES
+#       define CORO_STATS_LINES 128
+#   endif /* !CORO_STATS_LINES */
+
+    /**
+     * @brief Per-thread counters for one stackless coroutine function.
+     * 
+     * @note Suspension points are told apart by their line relative to
+     *       @c CORO_BEGIN, as stored in the coroutine's state; yields from
+     *       @c CORO_STATS_LINES - 1 lines on, or with an explicit line
+     *       number, share the last slot.
+     */
+    typedef struct Coro_Stats {
+        char const* name;
+        char const* file;
+        unsigned long line;         /**< Line of @c CORO_BEGIN. */
+        struct Coro_Stats* next;
+        bool linked;
+        unsigned long entries;      /**< Calls, first or resumed. */
+        unsigned long yields;       /**< Suspensions, awaits included. */
+        unsigned long completions;  /**< Runs reaching @c CORO_END. */
+        unsigned long lines[CORO_STATS_LINES];
+    } Coro_Stats;
+
+#   ifdef CORO_IMPLEMENTATION
+        thread_local Coro_Stats* coro_stats_head = NULL;
+#   else
+        extern thread_local Coro_Stats* coro_stats_head;
+#   endif
+
+    static_inline Coro_Stats* __coro_stats_enter(Coro_Stats *const stats) {
+        if UNLIKELY(!stats->linked) {
+            stats->next = coro_stats_head;
+            stats->linked = true;
+            coro_stats_head = stats;
+        }
+        ++stats->entries;
+        return stats;
+    }
+    static_inline void __coro_stats_yield(
+        Coro_Stats *const stats,
+        unsigned long line
+    ) {
+        ++stats->yields;
+        ++stats->lines[MIN(line, CORO_STATS_LINES - 1)];
+    }
+
+    /**
+     * @brief Gets the counters of every coroutine function the calling
+     *        thread has entered, linked through @e next.
+     */
+    static_inline Coro_Stats* coro_stats_list(void) {
+        return coro_stats_head;
+    }
+
+    /**
+     * @brief Zeroes the calling thread's counters.
+     */
+    static_inline void coro_stats_reset(void) {
+        Coro_Stats* stats;
+        for (stats = coro_stats_head; stats; stats = stats->next) {
+            stats->entries = stats->yields = stats->completions = 0;
+            memset(stats->lines, 0, sizeof(stats->lines));
+        }
+    }
+
+    /**
+     * @brief Prints the calling thread's counters, one coroutine per line
+     *        followed by each suspension point that was hit.
+     */
+    static_inline void coro_stats_dump(FILE *const out) {
+        Coro_Stats const* stats;
+        for (stats = coro_stats_head; stats; stats = stats->next) {
+            unsigned long i;
+            fprintf(out, "%s (%s:%lu): entries=%lu yields=%lu "
+                "completions=%lu\n", stats->name, stats->file, stats->line,
+                stats->entries, stats->yields, stats->completions
+            );
+            for (i = 0; i < CORO_STATS_LINES; ++i) {
+                if (stats->lines[i])
+                    fprintf(out, "  line %lu%s: %lu\n", stats->line + i,
+                        i == CORO_STATS_LINES - 1 ? "+" : "", stats->lines[i]
+                    );
+            }
+        }
+    }
+
+#   define _CORO_STATS_BEGIN(name) \
+        static thread_local Coro_Stats _coro_site = { \
+            #name, __FILE__, __LINE__ \
+        }; \
+        Coro_Stats *const _coro_stats = __coro_stats_enter(&_coro_site);
+#   define _CORO_STATS_END ++_coro_stats->completions;
+#   define _CORO_SETSTATE(id, line) ( \
+        __coro_stats_yield(_coro_stats, (unsigned long)(line)), \
+        _CORO_SETSTATE_(id, line) \
+    )
+#else
+#   define _CORO_STATS_BEGIN(name)
+#   define _CORO_STATS_END
+#   define _CORO_SETSTATE _CORO_SETSTATE_
+#endif /* CORO_USE_STATS */
+
+#define CORO_BEGIN(name) do { \
+    enum { _lineoff = __LINE__ }; \
+    Coro_Stack *const coro_next = &coro[_CORO_FRAME_SIZE_ ##name]; \
+    _CoroFrame ##name *const frame = (_CoroFrame ##name*)&coro[1]; \
+    _CORO_STATS_BEGIN(name) \
+    (void)frame; (void)coro_next; \
+    _CORO_DISPATCH
 
 #define CORO_YIELD_(line, value) do { \
-    coro[0] = (Coro_Stack)(line); \
+    _CORO_SETSTATE(line, line); \
     return value; \
-case line:; } while (0)
+_CORO_LABEL(line, line):; } while (0)
 #ifndef _NO_VA_ARGS
 #   define _CORO_YIELD0() _CORO_YIELD1()
 #   define _CORO_YIELD1(value) do { \
-        coro[0] = (Coro_Stack)(__LINE__ - _lineoff); \
+        _CORO_SETSTATE(__LINE__, __LINE__ - _lineoff); \
         return value; \
-    case __LINE__ - _lineoff:; } while (0)
+    _CORO_LABEL(__LINE__, __LINE__ - _lineoff):; } while (0)
 #   define _CORO_YIELD2(line, value) CORO_YIELD_(line, value)
 #   define _CORO_YIELD11(line) CONCATENATE(_CORO_YIELD11,VARGEMPTY(line))(line)
 #   define _CORO_YIELD111() _CORO_YIELD1()
@@ -1158,9 +2156,9 @@ case line:; } while (0)
 #   define _CORO_RESTORE2(a,b) b = frame->a
 #else
 #   define CORO_YIELD(value) do { \
-        coro[0] = (Coro_Stack)(__LINE__ - _lineoff); \
+        _CORO_SETSTATE(__LINE__, __LINE__ - _lineoff); \
         return value; \
-    case __LINE__ - _lineoff:; } while (0)
+    _CORO_LABEL(__LINE__, __LINE__ - _lineoff):; } while (0)
 #endif
 #ifdef _GNUC_VA_ARGS
 #   define _CORO_YIELD00(line, value, args...) do { \
@@ -1170,8 +2168,8 @@ case line:; } while (0)
     } while (0)
 #   define CORO_YIELD(args...) \
         _CORO_INVOKE(_PASTE3,(_CORO_YIELD, \
-            VARGEMPTY _TUPTAIL(args), \
-            VARGEMPTY _TUPTAIL _TUPTAIL(args) \
+            VARGEMPTY(_TUPTAIL(args)), \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(args))) \
         ))(args)
 #elif !defined _NO_VA_ARGS
 #   define _CORO_YIELD00(line, value, ...) do { \
@@ -1181,8 +2179,8 @@ case line:; } while (0)
     } while (0)
 #   define CORO_YIELD(...) \
         _CORO_INVOKE(_PASTE3,(_CORO_YIELD, \
-            VARGEMPTY _TUPTAIL(__VA_ARGS__), \
-            VARGEMPTY _TUPTAIL _TUPTAIL(__VA_ARGS__) \
+            VARGEMPTY(_TUPTAIL(__VA_ARGS__)), \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(__VA_ARGS__))) \
         ))(__VA_ARGS__)
 #endif
 
@@ -1190,6 +2188,878 @@ case line:; } while (0)
     if (coro[0]) coro[0] = 0; \
     return value; \
 } while (0)
-#define CORO_END(value) while (0); } while (0); CORO_RETURN(value)
+#define CORO_END(value) \
+    while (0); _CORO_STATS_END } } while (0); CORO_RETURN(value)
+
+/**
+ * @def CORO_EMIT
+ * @brief Appends a value to a generator's output buffer, yielding only once
+ *        the buffer is full.
+ * 
+ * @param out   The caller's output buffer.
+ * @param n     A @c size_t local set to 0 before @c CORO_BEGIN; counts the
+ *              values in @e out and is what's yielded.
+ * @param cap   The capacity of @e out.
+ * @param value The value to append.
+ * @param ...   Locals to save in @c frame across the yield, as with
+ *              @c CORO_YIELD.
+ * 
+ * @note A batched generator takes a fresh buffer on every call and returns
+ *       how many values it wrote, so the dispatch and any saving of locals
+ *       happen once per buffer rather than once per value. Yield a partial
+ *       batch with @c CORO_YIELD(n) when input runs out, and end with
+ *       @c CORO_END(n).
+ */
+#ifndef _NO_VA_ARGS
+#   define _CORO_EMIT1(out, n, cap, value) do { \
+        (out)[(n)++] = (value); \
+        if UNLIKELY((n) == (cap)) \
+            CORO_YIELD(, n); \
+    } while (0)
+#   ifdef _GNUC_VA_ARGS
+#       define _CORO_EMIT0(out, n, cap, value, args...) do { \
+            (out)[(n)++] = (value); \
+            if UNLIKELY((n) == (cap)) \
+                CORO_YIELD(, n, args); \
+        } while (0)
+#       define CORO_EMIT(args...) CONCATENATE(_CORO_EMIT, \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(_TUPTAIL(_TUPTAIL(args))))) \
+        )(args)
+#   else
+#       define _CORO_EMIT0(out, n, cap, value, ...) do { \
+            (out)[(n)++] = (value); \
+            if UNLIKELY((n) == (cap)) \
+                CORO_YIELD(, n, __VA_ARGS__); \
+        } while (0)
+#       define CORO_EMIT(...) CONCATENATE(_CORO_EMIT, \
+            VARGEMPTY(_TUPTAIL(_TUPTAIL(_TUPTAIL(_TUPTAIL(__VA_ARGS__))))) \
+        )(__VA_ARGS__)
+#   endif
+#else
+#   define CORO_EMIT(out, n, cap, value) do { \
+        (out)[(n)++] = (value); \
+        if UNLIKELY((n) == (cap)) \
+            CORO_YIELD(n); \
+    } while (0)
+#endif
+
+/**
+ * @brief A chain of stackless coroutines which await one another.
+ * 
+ * @note Only the innermost suspended frame is re-entered on resume, so the
+ *       cost of a resume doesn't grow with how deeply coroutines are nested.
+ */
+typedef struct Coro_Task {
+    Coro_Stack* leaf;   /**< Innermost suspended frame; NULL once finished. */
+    uintptr_t value;    /**< Last value yielded or returned. */
+    uintptr_t up;       /**< User parameter shared by every frame. */
+} Coro_Task;
+
+/**
+ * @brief Function signature for a stackless coroutine usable with
+ *        @c CORO_AWAIT and @c coro_task_resume.
+ */
+typedef uintptr_t (CDECL* Coro_Awaitable)(
+    Coro_Task *const task,
+    Coro_Stack* coro
+);
+
+/**
+ * @brief Number of @c Coro_Stack words placed before each awaited frame,
+ *        holding its function and its parent frame.
+ */
+#define CORO_AWAIT_HEADER 2
+
+/**
+ * @brief Calls an awaitable coroutine from inside another, storing its
+ *        result in @e result.
+ * 
+ * @param callee The @c Coro_Awaitable to run in the frame after this one.
+ * @param result An lvalue to receive the value @e callee returns.
+ * 
+ * @note If @e callee suspends, the caller suspends too, passing on the value
+ *       @e callee yielded, and is re-entered only once @e callee has
+ *       finished. Locals must be saved in @c frame across the call, as with
+ *       @c CORO_YIELD.
+ */
+#define CORO_AWAIT(callee, result) do { \
+    coro_next[0] = (Coro_Stack)(uintptr_t)(Coro_Awaitable)(callee); \
+    coro_next[1] = (Coro_Stack)(uintptr_t)coro; \
+    coro_next[CORO_AWAIT_HEADER] = 0; \
+    (result) = (callee)(task, coro_next + CORO_AWAIT_HEADER); \
+    if (coro_next[CORO_AWAIT_HEADER]) { \
+        if (!task->leaf) \
+            task->leaf = coro_next + CORO_AWAIT_HEADER; \
+        _CORO_SETSTATE(__LINE__, __LINE__ - _lineoff); \
+        return (result); \
+    _CORO_LABEL(__LINE__, __LINE__ - _lineoff): \
+        (result) = task->value; \
+    } \
+} while (0)
+
+/**
+ * @brief Prepares a task to run an awaitable coroutine.
+ * 
+ * @param[out] task  The task to initialize.
+ * @param[out] stack Storage for every frame in the chain; each frame takes
+ *                   @c CORO_AWAIT_HEADER words on top of its own size.
+ * @param[in]  func  The outermost coroutine.
+ * @param[in]  param A user parameter, available to every frame as
+ *                   @c task->up.
+ */
+static_inline void coro_task_init(
+    Coro_Task *const task,
+    Coro_Stack *const stack,
+    Coro_Awaitable func,
+    uintptr_t param
+) {
+    stack[0] = (Coro_Stack)(uintptr_t)func;
+    stack[1] = 0;
+    stack[CORO_AWAIT_HEADER] = 0;
+    task->leaf = stack + CORO_AWAIT_HEADER;
+    task->value = 0;
+    task->up = param;
+}
+
+/**
+ * @brief Resumes a task from its innermost suspended frame.
+ * 
+ * @param[in,out] task The task to resume.
+ * 
+ * @note Frames which finish hand their result straight to their parent, so
+ *       only finished levels are unwound.
+ * 
+ * @returns @c true if the task suspended, with the yielded value in
+ *          @e value; @c false if it finished, with its result in @e value.
+ */
+static_inline bool coro_task_resume(
+    Coro_Task *const task
+) {
+    Coro_Stack* frame = task->leaf;
+
+    if UNLIKELY(!frame)
+        return false;
+
+    for (;;) {
+        Coro_Awaitable func = (Coro_Awaitable)(uintptr_t)frame[-2];
+
+        task->leaf = NULL;
+        task->value = (*func)(task, frame);
+        if (frame[0]) {
+            if (!task->leaf)
+                task->leaf = frame;
+            return true;
+        }
+
+        if (!(frame = (Coro_Stack*)(uintptr_t)frame[-1]))
+            return false;
+    }
+}
+
+#ifdef CORO_USE_CHECKPOINTS
+#   include <fcntl.h>
+#   include <string.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+
+/**
+ * @brief Header at the start of a checkpoint file.
+ * 
+ * @note Two slots follow the header; saves alternate between them and the
+ *       one with the higher valid sequence number is current, so a crash in
+ *       the middle of a save leaves the previous checkpoint intact.
+ */
+typedef struct Coro_CheckpointHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t word_size;
+    uint32_t dispatch;  /**< 1 for label offsets, 0 for line numbers. */
+    uint64_t tag;       /**< Caller-chosen build or format identifier. */
+    uint64_t words;     /**< @c Coro_Stack words per slot. */
+    uint64_t seq[2];
+    uint64_t sum[2];
+} Coro_CheckpointHeader;
+
+/**
+ * @brief A checkpoint file mapped into memory.
+ */
+typedef struct Coro_Checkpoint {
+    Coro_CheckpointHeader* head;
+    Coro_Stack* slots;
+    size_t words;
+    size_t map_size;
+} Coro_Checkpoint;
+
+#   define CORO_CHECKPOINT_VERSION 1
+
+static_inline uint64_t __coro_checkpoint_sum(
+    Coro_Stack const* stack,
+    size_t words
+) {
+    unsigned char const* p = (unsigned char const*)stack;
+    size_t n = words * sizeof(Coro_Stack);
+    uint64_t h = UINT64_C(14695981039346656037);
+
+    while (n--)
+        h = (h ^ *p++) * UINT64_C(1099511628211);
+    return h;
+}
+
+/**
+ * @brief Opens a checkpoint file, creating it if it doesn't exist.
+ * 
+ * @param[out] cp    The checkpoint to open.
+ * @param[in]  path  The file's path.
+ * @param[in]  words The size of the coroutine stack to checkpoint.
+ * @param[in]  tag   An identifier for the code the stack belongs to, such as
+ *                   a build ID. Files saved with a different tag are refused.
+ * 
+ * @note A checkpoint is only meaningful to the same binary: saved states are
+ *       resume points within its functions. Stacks holding pointers, such as
+ *       @c Coro_Task chains, can't be checkpointed.
+ * 
+ * @returns @c true on success; @c false if the file couldn't be mapped or
+ *          belongs to a different version, tag, size or build.
+ */
+static_inline bool coro_checkpoint_open(
+    Coro_Checkpoint *const cp,
+    char const* path,
+    size_t words,
+    uint64_t tag
+) {
+    Coro_CheckpointHeader* head;
+    struct stat st;
+    size_t size = sizeof(Coro_CheckpointHeader) +
+        2 * words * sizeof(Coro_Stack);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) || (
+        (size_t)st.st_size != size && (st.st_size || ftruncate(fd, size))
+    )) {
+        close(fd);
+        return false;
+    }
+
+    head = (Coro_CheckpointHeader*)mmap(
+        NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+    );
+    close(fd);
+    if (head == (Coro_CheckpointHeader*)MAP_FAILED)
+        return false;
+
+    if (!st.st_size) {
+        memcpy(head->magic, "CoCk", 4);
+        head->version = CORO_CHECKPOINT_VERSION;
+        head->word_size = sizeof(Coro_Stack);
+        head->dispatch = _CORO_DISPATCH_KIND;
+        head->tag = tag;
+        head->words = words;
+    } else if (
+        memcmp(head->magic, "CoCk", 4) ||
+        head->version != CORO_CHECKPOINT_VERSION ||
+        head->word_size != sizeof(Coro_Stack) ||
+        head->dispatch != _CORO_DISPATCH_KIND ||
+        head->tag != tag ||
+        head->words != words
+    ) {
+        munmap((void*)head, size);
+        return false;
+    }
+
+    cp->head = head;
+    cp->slots = (Coro_Stack*)(head + 1);
+    cp->words = words;
+    cp->map_size = size;
+    return true;
+}
+
+/**
+ * @brief Copies the newest intact checkpoint into a coroutine stack.
+ * 
+ * @param[in]  cp    The checkpoint to read.
+ * @param[out] stack The stack to restore; resuming it continues from the
+ *                   last save.
+ * 
+ * @returns @c true on success; @c false if nothing has been saved yet.
+ */
+static_inline bool coro_checkpoint_load(
+    Coro_Checkpoint const *const cp,
+    Coro_Stack *const stack
+) {
+    Coro_CheckpointHeader const* head = cp->head;
+    int i, best = -1;
+
+    for (i = 0; i < 2; ++i) {
+        if (!head->seq[i] || (best >= 0 && head->seq[i] < head->seq[best]))
+            continue;
+        if (__coro_checkpoint_sum(cp->slots + i * cp->words, cp->words) ==
+            head->sum[i])
+            best = i;
+    }
+
+    if (best < 0)
+        return false;
+    memcpy(stack, cp->slots + best * cp->words, cp->words * sizeof(Coro_Stack));
+    return true;
+}
+
+/**
+ * @brief Saves a coroutine stack to the checkpoint durably.
+ * 
+ * @param[in,out] cp    The checkpoint to write.
+ * @param[in]     stack The stack to save, normally just after it yielded.
+ * 
+ * @returns @c true on success; @c false if the data couldn't be flushed.
+ */
+static_inline bool coro_checkpoint_save(
+    Coro_Checkpoint *const cp,
+    Coro_Stack const *const stack
+) {
+    Coro_CheckpointHeader* head = cp->head;
+    int i = head->seq[0] > head->seq[1];
+    uint64_t seq = head->seq[!i];
+
+    /* write the older slot; its header fields only change once it's on disk */
+    memcpy(cp->slots + i * cp->words, stack, cp->words * sizeof(Coro_Stack));
+    head->sum[i] = __coro_checkpoint_sum(stack, cp->words);
+    if (msync((void*)head, cp->map_size, MS_SYNC))
+        return false;
+
+    head->seq[i] = seq + 1;
+    return !msync((void*)head, cp->map_size, MS_SYNC);
+}
+
+/**
+ * @brief Unmaps a checkpoint file.
+ */
+static_inline void coro_checkpoint_close(
+    Coro_Checkpoint *const cp
+) {
+    munmap((void*)cp->head, cp->map_size);
+    cp->head = NULL;
+    cp->slots = NULL;
+}
+#endif /* CORO_USE_CHECKPOINTS */
+
+/* == C++20 COROUTINES ====================================================== */
+
+#if CPP_PREREQ(202002L) && __has_include(<coroutine>) && !defined(CORO_NO_TASKS)
+#   include <coroutine>
+#   include <cstddef>
+#   include <exception>
+#   include <new>
+#   include <optional>
+#   include <type_traits>
+#   include <utility>
+#   include "thread.h"
+
+namespace coro {
+    class run_queue;
+
+    /* a suspended coroutine waiting to be resumed, stored in its own frame */
+    struct __waiter {
+        __waiter* next;
+        std::coroutine_handle<> handle;
+        run_queue* queue;
+    };
+
+    /* intrusive FIFO of waiters; callers hold whatever lock guards it */
+    struct __waiter_list {
+        __waiter* head = nullptr;
+        __waiter* tail = nullptr;
+
+        void push(__waiter* w) noexcept {
+            w->next = nullptr;
+            if (this->tail)
+                this->tail->next = w;
+            else
+                this->head = w;
+            this->tail = w;
+        }
+
+        __waiter* pop() noexcept {
+            __waiter* w = this->head;
+            if (w && !(this->head = w->next))
+                this->tail = nullptr;
+            return w;
+        }
+    };
+
+    /**
+     * @brief A queue of coroutines ready to be resumed.
+     * 
+     * @note Any thread may add to a queue. Coroutines woken by a
+     *       @c coro::semaphore or @c coro::mutex are put back on the queue
+     *       they suspended from, so they keep running on the same thread or
+     *       fiber instead of whichever thread released them.
+     */
+    class run_queue {
+    public:
+        run_queue() noexcept {
+            mtx_init(&this->lock, mtx_plain);
+        }
+
+        ~run_queue() {
+            mtx_destroy(&this->lock);
+        }
+
+        run_queue(run_queue const&) = delete;
+        run_queue& operator=(run_queue const&) = delete;
+
+        /**
+         * @brief Resumes queued coroutines until the queue is empty.
+         * 
+         * @returns The number of coroutines resumed.
+         */
+        size_t run() {
+            run_queue* prev = current_queue;
+            size_t n = 0;
+
+            current_queue = this;
+            while (__waiter* w = this->pop()) {
+                w->handle.resume();
+                ++n;
+            }
+            current_queue = prev;
+            return n;
+        }
+
+        /**
+         * @brief Awaitable which moves the awaiting coroutine onto this
+         *        queue.
+         */
+        auto schedule() noexcept {
+            struct awaiter {
+                run_queue& queue;
+                __waiter node;
+
+                bool await_ready() const noexcept { return false; }
+                void await_suspend(std::coroutine_handle<> h) noexcept {
+                    this->node.handle = h;
+                    this->node.queue = &this->queue;
+                    this->queue.post(&this->node);
+                }
+                void await_resume() const noexcept {}
+            };
+            return awaiter{*this, {}};
+        }
+
+        /**
+         * @brief The queue being run on the calling thread, if any.
+         */
+        static run_queue* current() noexcept {
+            return current_queue;
+        }
+
+#   ifndef CORO_NO_FIBERS
+        /**
+         * @brief A @c Coro_Function which runs the queue passed as its
+         *        parameter, suspending each time the queue empties.
+         * 
+         * @note Pass this to @c fiber_init to drive coroutines from a fiber;
+         *       every @c fiber_resume then runs whatever has become ready.
+         */
+        static int CDECL fiber_main(
+            Coro_Fiber *const coro,
+            uintptr_t param
+        ) {
+            for (;;) {
+                reinterpret_cast<run_queue*>(param)->run();
+                fiber_suspend(coro);
+            }
+        }
+#   endif /* !CORO_NO_FIBERS */
+
+        void post(__waiter* w) noexcept {
+            mtx_lock(&this->lock);
+            this->ready.push(w);
+            mtx_unlock(&this->lock);
+        }
+
+    private:
+        __waiter* pop() noexcept {
+            mtx_lock(&this->lock);
+            __waiter* w = this->ready.pop();
+            mtx_unlock(&this->lock);
+            return w;
+        }
+
+        static inline thread_local run_queue* current_queue = nullptr;
+        mtx_t lock;
+        __waiter_list ready;
+    };
+
+    static_inline void __wake(__waiter* w) {
+        if (w->queue)
+            w->queue->post(w);
+        else
+            w->handle.resume();
+    }
+
+    /**
+     * @brief Awaitable adapter over a thread.h @c sem_t.
+     * 
+     * @note Threads may block on @c native_handle with @c sem_wait while
+     *       coroutines @c co_await @c acquire. Permits given with @c release
+     *       go to suspended coroutines first; a bare @c sem_post only wakes
+     *       threads.
+     */
+    class semaphore {
+    public:
+        explicit semaphore(unsigned value = 0) noexcept {
+            sem_init(&this->sem, 0, value);
+            mtx_init(&this->lock, mtx_plain);
+        }
+
+        ~semaphore() {
+            mtx_destroy(&this->lock);
+            sem_destroy(&this->sem);
+        }
+
+        semaphore(semaphore const&) = delete;
+        semaphore& operator=(semaphore const&) = delete;
+
+        bool try_acquire() noexcept {
+            return sem_trywait(&this->sem) == 0;
+        }
+
+        /**
+         * @brief Awaitable which takes a permit, suspending until one is
+         *        available.
+         */
+        auto acquire() noexcept {
+            struct awaiter {
+                semaphore& sem;
+                __waiter node;
+
+                bool await_ready() noexcept {
+                    return this->sem.try_acquire();
+                }
+                bool await_suspend(std::coroutine_handle<> h) noexcept {
+                    mtx_lock(&this->sem.lock);
+                    if (this->sem.try_acquire()) {
+                        mtx_unlock(&this->sem.lock);
+                        return false;
+                    }
+
+                    this->node.handle = h;
+                    this->node.queue = run_queue::current();
+                    this->sem.waiters.push(&this->node);
+                    mtx_unlock(&this->sem.lock);
+                    return true;
+                }
+                void await_resume() const noexcept {}
+            };
+            return awaiter{*this, {}};
+        }
+
+        /**
+         * @brief Gives back a permit, handing it straight to the oldest
+         *        suspended coroutine if there is one.
+         */
+        void release() {
+            mtx_lock(&this->lock);
+            __waiter* w = this->waiters.pop();
+            if (!w)
+                sem_post(&this->sem);
+            mtx_unlock(&this->lock);
+
+            if (w)
+                __wake(w);
+        }
+
+        sem_t* native_handle() noexcept {
+            return &this->sem;
+        }
+
+    private:
+        sem_t sem;
+        mtx_t lock;
+        __waiter_list waiters;
+    };
+
+    /**
+     * @brief A mutex which suspends awaiting coroutines rather than blocking
+     *        their thread.
+     * 
+     * @note Ownership belongs to a coroutine, not a thread, so it can be
+     *       unlocked from wherever the owner has been resumed. Its state is
+     *       guarded by a thread.h @c mtx_t held only for a few instructions.
+     */
+    class mutex {
+    public:
+        mutex() noexcept {
+            mtx_init(&this->guard, mtx_plain);
+        }
+
+        ~mutex() {
+            mtx_destroy(&this->guard);
+        }
+
+        mutex(mutex const&) = delete;
+        mutex& operator=(mutex const&) = delete;
+
+        bool try_lock() noexcept {
+            mtx_lock(&this->guard);
+            bool acquired = !this->locked;
+            this->locked = true;
+            mtx_unlock(&this->guard);
+            return acquired;
+        }
+
+        /**
+         * @brief Awaitable which locks the mutex.
+         */
+        auto lock() noexcept {
+            struct awaiter {
+                mutex& mtx;
+                __waiter node;
+
+                bool await_ready() noexcept {
+                    return this->mtx.try_lock();
+                }
+                bool await_suspend(std::coroutine_handle<> h) noexcept {
+                    mtx_lock(&this->mtx.guard);
+                    if (!this->mtx.locked) {
+                        this->mtx.locked = true;
+                        mtx_unlock(&this->mtx.guard);
+                        return false;
+                    }
+
+                    this->node.handle = h;
+                    this->node.queue = run_queue::current();
+                    this->mtx.waiters.push(&this->node);
+                    mtx_unlock(&this->mtx.guard);
+                    return true;
+                }
+                void await_resume() const noexcept {}
+            };
+            return awaiter{*this, {}};
+        }
+
+        /**
+         * @brief Unlocks the mutex, passing ownership to the oldest
+         *        suspended coroutine if there is one.
+         */
+        void unlock() {
+            mtx_lock(&this->guard);
+            __waiter* w = this->waiters.pop();
+            if (!w)
+                this->locked = false;
+            mtx_unlock(&this->guard);
+
+            if (w)
+                __wake(w);
+        }
+
+    private:
+        mtx_t guard;
+        bool locked = false;
+        __waiter_list waiters;
+    };
+
+#   ifndef CORO_FRAME_CLASSES
+#       define CORO_FRAME_CLASSES 32
+#   endif /* !CORO_FRAME_CLASSES */
+
+    /* per-thread free lists of coroutine frames in 64 byte size classes */
+    struct __frame_cache {
+        struct block { block* next; };
+        block* lists[CORO_FRAME_CLASSES] = {};
+
+        ~__frame_cache() {
+            for (block*& head : this->lists) {
+                while (block* b = head) {
+                    head = b->next;
+                    ::operator delete(b);
+                }
+            }
+        }
+
+        static __frame_cache& local() noexcept {
+            static thread_local __frame_cache cache;
+            return cache;
+        }
+
+        static void* allocate(size_t size) {
+            size_t c = (size + 63) >> 6;
+            if (c >= CORO_FRAME_CLASSES)
+                return ::operator new(size);
+
+            block*& head = local().lists[c];
+            if (block* b = head) {
+                head = b->next;
+                return b;
+            }
+            return ::operator new(c << 6);
+        }
+
+        static void deallocate(void* p, size_t size) noexcept {
+            size_t c = (size + 63) >> 6;
+            if (c >= CORO_FRAME_CLASSES) {
+                ::operator delete(p);
+                return;
+            }
+
+            block*& head = local().lists[c];
+            block* b = static_cast<block*>(p);
+            b->next = head;
+            head = b;
+        }
+    };
+
+    template <typename T = void>
+    class task;
+
+    struct __task_promise_base {
+        std::coroutine_handle<> continuation;
+        std::exception_ptr error;
+        bool detached = false;
+        __waiter node;
+
+        static void* operator new(size_t size) {
+            return __frame_cache::allocate(size);
+        }
+        static void operator delete(void* p, size_t size) noexcept {
+            __frame_cache::deallocate(p, size);
+        }
+
+        struct final_awaiter {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename P>
+            std::coroutine_handle<> await_suspend(
+                std::coroutine_handle<P> h
+            ) noexcept {
+                __task_promise_base& p = h.promise();
+                if (p.continuation)
+                    return p.continuation;
+                if (p.detached)
+                    h.destroy();
+                return std::noop_coroutine();
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter final_suspend() const noexcept { return {}; }
+
+        void unhandled_exception() noexcept {
+            if (this->detached)
+                std::terminate();
+            this->error = std::current_exception();
+        }
+    };
+
+    template <typename T>
+    struct __task_promise : __task_promise_base {
+        std::optional<T> value;
+
+        task<T> get_return_object() noexcept;
+
+        template <typename U>
+        void return_value(U&& v) {
+            this->value.emplace(std::forward<U>(v));
+        }
+    };
+
+    template <>
+    struct __task_promise<void> : __task_promise_base {
+        task<void> get_return_object() noexcept;
+
+        void return_void() const noexcept {}
+    };
+
+    /**
+     * @brief A lazily started coroutine producing a @e T.
+     * 
+     * @note The task starts when awaited and resumes its awaiter when it
+     *       finishes. Frames are recycled through per-thread free lists,
+     *       so a steady stream of tasks stops allocating once warmed up.
+     */
+    template <typename T>
+    class task {
+    public:
+        typedef __task_promise<T> promise_type;
+
+        task(task&& other) noexcept :
+            handle(std::exchange(other.handle, nullptr)) {}
+
+        task& operator=(task&& other) noexcept {
+            if (this != &other) {
+                if (this->handle)
+                    this->handle.destroy();
+                this->handle = std::exchange(other.handle, nullptr);
+            }
+            return *this;
+        }
+
+        ~task() {
+            if (this->handle)
+                this->handle.destroy();
+        }
+
+        bool await_ready() const noexcept {
+            return false;
+        }
+
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<> awaiter
+        ) noexcept {
+            this->handle.promise().continuation = awaiter;
+            return this->handle;
+        }
+
+        T await_resume() {
+            promise_type& p = this->handle.promise();
+            if (p.error)
+                std::rethrow_exception(p.error);
+            if constexpr (!std::is_void_v<T>)
+                return std::move(*p.value);
+        }
+
+        /**
+         * @brief Starts a task with nobody awaiting it.
+         * 
+         * @param[in,out] queue The queue to first resume the task from.
+         * @param[in]     t     The task, which frees itself when it finishes.
+         * 
+         * @note An exception escaping a detached task terminates the program.
+         */
+        friend void spawn(run_queue& queue, task t) noexcept {
+            promise_type& p = t.handle.promise();
+            p.detached = true;
+            p.node.handle = std::exchange(t.handle, nullptr);
+            p.node.queue = &queue;
+            queue.post(&p.node);
+        }
+
+    private:
+        friend promise_type;
+
+        explicit task(std::coroutine_handle<promise_type> h) noexcept :
+            handle(h) {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    template <typename T>
+    task<T> __task_promise<T>::get_return_object() noexcept {
+        return task<T>(std::coroutine_handle<__task_promise>::from_promise(
+            *this
+        ));
+    }
+
+    inline task<void> __task_promise<void>::get_return_object() noexcept {
+        return task<void>(std::coroutine_handle<__task_promise>::from_promise(
+            *this
+        ));
+    }
+}
+#endif /* CPP_PREREQ(202002L) && !CORO_NO_TASKS */
 
 #endif /* CORO_H_ */
@@ -0,0 +1,215 @@
+/**
+ * @file counter.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Sharded statistics counters which don't bounce cache lines between
+ *        cores.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef COUNTER_H_
+#define COUNTER_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+#include "thread.h"
+#if CPP_PREREQ(1L)
+#   include <cstdlib>
+#else
+#   include <stdlib.h>
+#endif
+
+#ifndef COUNTER_CACHE_LINE
+#   define COUNTER_CACHE_LINE 64
+#endif /* !COUNTER_CACHE_LINE */
+
+#ifndef COUNTER_SHARDS
+#   define COUNTER_SHARDS 32
+#endif /* !COUNTER_SHARDS */
+
+#ifdef COUNTER_USE_CPU
+#   if defined(_WIN32)
+#       include <windows.h>
+#       define __COUNTER_CPU() GetCurrentProcessorNumber()
+#   elif defined(__linux__)
+#       include <sched.h>
+#       define __COUNTER_CPU() (uint32_t)sched_getcpu()
+#   endif
+#endif
+
+/* == COUNTERS ============================================================== */
+
+/**
+ * @brief One shard of a counter, alone on its cache line.
+ */
+typedef struct Counter_Shard {
+    atomic_uint64 value;
+    uint8_t pad[COUNTER_CACHE_LINE - sizeof(atomic_uint64)];
+} Counter_Shard;
+
+/**
+ * @brief A 64-bit counter split into cache line sized shards.
+ * 
+ * @note Each thread adds into its own shard, so increments from different
+ *       cores don't contend; reading sums every shard.
+ */
+typedef struct Counter {
+    Counter_Shard* shards;
+    void* alloc;
+    uint32_t mask;
+} Counter;
+
+#ifndef __COUNTER_CPU
+#   ifdef _NO_THREAD_LOCAL
+        static tss_t __counter_key;
+        static once_flag __counter_once = ONCE_FLAG_INIT;
+
+        static void __counter_key_create(void) {
+            tss_create(&__counter_key, NULL);
+        }
+#   endif
+
+    /* numbers threads in the order they first touch a counter */
+    static_inline uint32_t __counter_thread_index(void) {
+        static atomic_uint32 next;
+#   ifndef _NO_THREAD_LOCAL
+        static thread_local uint32_t index;
+
+        if UNLIKELY(!index)
+            index = atomic_fetch_add_uint32(&next, 1) + 1;
+        return index - 1;
+#   else
+        uintptr_t index;
+
+        call_once(&__counter_once, __counter_key_create);
+        if UNLIKELY(!(index = (uintptr_t)tss_get(__counter_key))) {
+            index = atomic_fetch_add_uint32(&next, 1) + 1;
+            tss_set(__counter_key, (void*)index);
+        }
+        return (uint32_t)(index - 1);
+#   endif
+    }
+#endif
+
+static_inline Counter_Shard* __counter_shard(
+    Counter const *const counter
+) {
+#ifdef __COUNTER_CPU
+    return &counter->shards[__COUNTER_CPU() & counter->mask];
+#else
+    return &counter->shards[__counter_thread_index() & counter->mask];
+#endif
+}
+
+/**
+ * @brief Initializes a counter at zero.
+ * 
+ * @param[out] counter The counter to initialize.
+ * @param[in]  shards  Number of shards, rounded up to a power of two; 0 for
+ *                     @c COUNTER_SHARDS. More shards than concurrently
+ *                     counting threads only costs memory.
+ * 
+ * @note Threads take shards in the order they first touch any counter, or
+ *       by the CPU they run on when @c COUNTER_USE_CPU is defined on
+ *       Windows or Linux (which needs @c _GNU_SOURCE for @c sched_getcpu).
+ *       Elsewhere @c COUNTER_USE_CPU is ignored. If @c sched_getcpu fails,
+ *       its -1 lands every caller on the last shard, which stays correct
+ *       but contended.
+ * 
+ * @returns @c true on success; @c false if out of memory.
+ */
+static_inline bool counter_init(
+    Counter *const counter,
+    uint32_t shards
+) {
+    uint32_t count = 1, i;
+
+    while (count < (shards ? shards : COUNTER_SHARDS))
+        count <<= 1;
+
+    counter->alloc = malloc(
+        (size_t)count * sizeof(Counter_Shard) + COUNTER_CACHE_LINE - 1
+    );
+    if (!counter->alloc)
+        return false;
+
+    counter->shards = (Counter_Shard*)(
+        ((uintptr_t)counter->alloc + COUNTER_CACHE_LINE - 1) &
+        ~(uintptr_t)(COUNTER_CACHE_LINE - 1)
+    );
+    counter->mask = count - 1;
+    for (i = 0; i < count; ++i)
+        atomic_store_uint64(&counter->shards[i].value, 0);
+    return true;
+}
+
+/**
+ * @brief Frees a counter's shards.
+ */
+static_inline void counter_destroy(
+    Counter *const counter
+) {
+    free(counter->alloc);
+    counter->alloc = NULL;
+    counter->shards = NULL;
+}
+
+/**
+ * @brief Adds to a counter.
+ * 
+ * @note Touches only the calling thread's shard, which normally stays in
+ *       that core's cache.
+ */
+static_inline void counter_add(
+    Counter *const counter,
+    uint64_t n
+) {
+    atomic_fetch_add_uint64(&__counter_shard(counter)->value, n);
+}
+
+/**
+ * @brief Adds one to a counter.
+ */
+static_inline void counter_inc(
+    Counter *const counter
+) {
+    counter_add(counter, 1);
+}
+
+/**
+ * @brief Reads a counter by summing its shards.
+ * 
+ * @note Not a snapshot: increments made while summing may or may not be
+ *       included. Costs one cache miss per shard, so read rarely.
+ */
+static_inline uint64_t counter_read(
+    Counter const *const counter
+) {
+    uint64_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i <= counter->mask; ++i)
+        sum += atomic_load_uint64(&counter->shards[i].value);
+    return sum;
+}
+
+/**
+ * @brief Reads a counter and sets it back to zero.
+ * 
+ * @note No increment is lost: each one lands either in the value returned
+ *       or in the counter afterwards.
+ */
+static_inline uint64_t counter_exchange(
+    Counter *const counter
+) {
+    uint64_t sum = 0;
+    uint32_t i;
+
+    for (i = 0; i <= counter->mask; ++i)
+        sum += atomic_exchange_uint64(&counter->shards[i].value, 0);
+    return sum;
+}
+
+#endif /* COUNTER_H_ */
@@ -0,0 +1,552 @@
+/**
+ * @file hashmap.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Concurrent hash map with lock-free lookups and cooperative
+ *        resizing.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef HASHMAP_H_
+#define HASHMAP_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+#include "reclaim.h"
+#if CPP_PREREQ(1L)
+#   include <cstdlib>
+#else
+#   include <stdlib.h>
+#endif
+
+#ifndef HASHMAP_MIN_CAPACITY
+#   define HASHMAP_MIN_CAPACITY 16
+#endif /* !HASHMAP_MIN_CAPACITY */
+
+#ifndef HASHMAP_COPY_CHUNK
+#   define HASHMAP_COPY_CHUNK 64
+#endif /* !HASHMAP_COPY_CHUNK */
+
+/* reserved keys and values: unset, closed to new keys, removed, copied */
+#define __HASHMAP_EMPTY  ((uintptr_t)0)
+#define __HASHMAP_SEALED (~(uintptr_t)0)
+#define __HASHMAP_TOMB   (~(uintptr_t)0)
+#define __HASHMAP_MOVED  (~(uintptr_t)1)
+
+/* == TABLES ================================================================ */
+
+typedef struct Hashmap_Slot {
+    atomic_uintptr key, value;
+} Hashmap_Slot;
+
+/**
+ * @brief One generation of a map's storage.
+ * 
+ * @note While a table is being resized, @c next points to its successor and
+ *       threads claim @c HASHMAP_COPY_CHUNK slots at a time to copy across.
+ *       A copied slot's value is replaced with a marker sending readers on
+ *       to @c next, so lookups never wait for the copy to finish. Empty
+ *       slots are sealed so no key can land behind the copy.
+ */
+typedef struct Hashmap_Table {
+    atomic_uintptr next;
+    atomic_uint32 used;         /**< Key slots claimed or reserved. */
+    atomic_uint32 copy_claimed, copy_done;
+    uint32_t mask;
+    struct Hashmap_Table* prev; /**< Links tables waiting to be freed. */
+    Hashmap_Slot* slots;
+} Hashmap_Table;
+
+/**
+ * @brief A concurrent map from word-sized keys to word-sized values.
+ * 
+ * @note Keys must be nonzero and not @c UINTPTR_MAX; values must be nonzero
+ *       and not @c UINTPTR_MAX or @c UINTPTR_MAX - 1, as 0 means absent.
+ *       Keys compare by value, so store pointers or integers.
+ * 
+ * @note Every operation takes the caller's @c Reclaim_Thread, through which
+ *       replaced tables are retired with epoch-based reclamation; calls
+ *       must not already be inside a read-side section. Pass @c NULL to
+ *       every call instead to keep replaced tables until
+ *       @c hashmap_destroy.
+ */
+typedef struct Hashmap {
+    atomic_uintptr table;
+    atomic_uintptr retired;
+} Hashmap;
+
+static_inline void CDECL __hashmap_table_free(void* table) {
+    free(table);
+}
+
+static_inline Hashmap_Table* __hashmap_table_new(
+    uint32_t capacity
+) {
+    Hashmap_Table *const table = (Hashmap_Table*)calloc(
+        1, sizeof(Hashmap_Table) + (size_t)capacity * sizeof(Hashmap_Slot)
+    );
+    if (table) {
+        table->mask = capacity - 1;
+        table->slots = (Hashmap_Slot*)(table + 1);
+    }
+    return table;
+}
+
+static_inline uint32_t __hashmap_hash(
+    uintptr_t key
+) {
+#if WORD_SIZE == 64 && defined(_INT64_DEFINED)
+    uint64_t h = key;
+    h = (h ^ (h >> 33)) * UINT64_C(0xFF51AFD7ED558CCD);
+    h = (h ^ (h >> 33)) * UINT64_C(0xC4CEB9FE1A85EC53);
+    return (uint32_t)(h ^ (h >> 33));
+#else
+    uint32_t h = (uint32_t)key;
+    h = (h ^ (h >> 16)) * 0x85EBCA6Bu;
+    h = (h ^ (h >> 13)) * 0xC2B2AE35u;
+    return h ^ (h >> 16);
+#endif
+}
+
+/* finds a key's slot, or the empty or sealed slot ending its probe */
+static_inline Hashmap_Slot* __hashmap_find(
+    Hashmap_Table *const table,
+    uintptr_t key,
+    uint32_t hash,
+    uintptr_t *const found
+) {
+    uint32_t i = hash & table->mask, n;
+
+    for (n = 0; n <= table->mask; ++n, i = (i + 1) & table->mask) {
+        *found = atomic_load_uintptr(&table->slots[i].key);
+        if (*found == key || *found == __HASHMAP_EMPTY ||
+            *found == __HASHMAP_SEALED)
+            return &table->slots[i];
+    }
+    *found = __HASHMAP_SEALED;
+    return NULL;
+}
+
+/* moves one slot into the next table, then marks it as moved */
+static_inline void __hashmap_copy_slot(
+    Hashmap_Slot *const slot,
+    Hashmap_Table *const to
+) {
+    uintptr_t key = __HASHMAP_EMPTY, value;
+    Hashmap_Slot* target = NULL;
+
+    if (atomic_compare_exchange_strong_uintptr(
+        &slot->key, &key, __HASHMAP_SEALED
+    ) || key == __HASHMAP_SEALED)
+        return;
+
+    value = atomic_load_uintptr(&slot->value);
+    for (;;) {
+        if (target || (
+            value != __HASHMAP_EMPTY && value != __HASHMAP_TOMB
+        )) {
+            /* only this thread writes the key there until it's moved */
+            while (!target) {
+                uintptr_t found;
+
+                target = __hashmap_find(to, key, __hashmap_hash(key), &found);
+                if (found == key) {
+                    break;
+                } else if (atomic_compare_exchange_strong_uintptr(
+                    &target->key, &found, key
+                )) {
+                    atomic_fetch_add_uint32(&to->used, 1);
+                } else if (found != key) {
+                    target = NULL;
+                }
+            }
+            atomic_store_uintptr(&target->value, value);
+        }
+
+        if (atomic_compare_exchange_strong_uintptr(
+            &slot->value, &value, __HASHMAP_MOVED
+        ))
+            return;
+    }
+}
+
+/* copies chunks of a table until none are left to claim */
+static_inline void __hashmap_help(
+    Hashmap *const map,
+    Hashmap_Table *const from,
+    Hashmap_Table *const to,
+    Hashmap_Table** retire
+) {
+    uint32_t const capacity = from->mask + 1;
+
+    while (atomic_load_uint32(&from->copy_claimed) < capacity) {
+        uint32_t const start = atomic_fetch_add_uint32(
+            &from->copy_claimed, HASHMAP_COPY_CHUNK
+        );
+        uint32_t end, i;
+        uintptr_t expected = (uintptr_t)from;
+
+        if (start >= capacity)
+            break;
+        end = MIN(start + HASHMAP_COPY_CHUNK, capacity);
+        for (i = start; i < end; ++i)
+            __hashmap_copy_slot(&from->slots[i], to);
+
+        /* whoever copies the last chunk swaps the new table in */
+        if (atomic_fetch_add_uint32(&from->copy_done, end - start) ==
+                capacity - (end - start) &&
+            atomic_compare_exchange_strong_uintptr(
+                &map->table, &expected, (uintptr_t)to
+            )
+        ) {
+            from->prev = *retire;
+            *retire = from;
+        }
+    }
+}
+
+/* waits until a table is current or has a successor, helping meanwhile */
+static_inline void __hashmap_settle(
+    Hashmap *const map,
+    Hashmap_Table *const table,
+    Hashmap_Table** retire
+) {
+    Hashmap_Table* current;
+
+    while ((current = (Hashmap_Table*)atomic_load_uintptr(
+        &map->table
+    )) != table && !atomic_load_uintptr(&table->next)) {
+        if (atomic_load_uintptr(&current->next) == (uintptr_t)table)
+            __hashmap_help(map, current, table, retire);
+        cpu_relax();
+    }
+}
+
+/* doubles only if live keys, not tombstones, fill a quarter of a table */
+static_inline uint32_t __hashmap_next_capacity(
+    Hashmap_Table *const table
+) {
+    uint32_t const capacity = table->mask + 1;
+    uint32_t live = 0, i;
+
+    if (capacity >= UINT32_C(0x80000000))
+        return capacity;
+    for (i = 0; i < capacity && live < capacity / 4; ++i) {
+        uintptr_t const value = atomic_load_uintptr(&table->slots[i].value);
+        live += value != __HASHMAP_EMPTY && value != __HASHMAP_TOMB &&
+            value != __HASHMAP_MOVED;
+    }
+    return live < capacity / 4 ? capacity : capacity * 2;
+}
+
+/* starts or joins a table's resize, returning its successor */
+static_inline Hashmap_Table* __hashmap_grow(
+    Hashmap *const map,
+    Hashmap_Table *const table,
+    Hashmap_Table** retire
+) {
+    Hashmap_Table* next;
+
+    /* a table still being copied into must be swapped in first */
+    __hashmap_settle(map, table, retire);
+
+    if (!(next = (Hashmap_Table*)atomic_load_uintptr(&table->next))) {
+        uintptr_t expected = 0;
+
+        if (!(next = __hashmap_table_new(__hashmap_next_capacity(table))))
+            return NULL;
+        if (!atomic_compare_exchange_strong_uintptr(
+            &table->next, &expected, (uintptr_t)next
+        )) {
+            free(next);
+            next = (Hashmap_Table*)expected;
+        }
+    }
+
+    __hashmap_help(map, table, next, retire);
+    return next;
+}
+
+/* hands a replaced table to the reclamation scheme */
+static_inline void __hashmap_retire(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    Hashmap_Table *const table
+) {
+    if (thread) {
+        reclaim_ebr_retire(thread, table, __hashmap_table_free);
+    } else {
+        uintptr_t head = atomic_load_uintptr(&map->retired);
+        do {
+            table->prev = (Hashmap_Table*)head;
+        } while (!atomic_compare_exchange_weak_uintptr(
+            &map->retired, &head, (uintptr_t)table
+        ));
+    }
+}
+
+/* == MAPS ================================================================== */
+
+/**
+ * @brief Initializes an empty map.
+ * 
+ * @param[out] map      The map to initialize.
+ * @param[in]  capacity Expected number of keys; the map grows past it.
+ * 
+ * @returns @c true on success; @c false if out of memory.
+ */
+static_inline bool hashmap_init(
+    Hashmap *const map,
+    uint32_t capacity
+) {
+    uint32_t slots = HASHMAP_MIN_CAPACITY;
+    Hashmap_Table* table;
+
+    while (slots / 2 < capacity && slots < UINT32_C(0x80000000))
+        slots <<= 1;
+    if (!(table = __hashmap_table_new(slots)))
+        return false;
+
+    atomic_store_uintptr(&map->table, (uintptr_t)table);
+    atomic_store_uintptr(&map->retired, 0);
+    return true;
+}
+
+/**
+ * @brief Frees a map.
+ * 
+ * @note No other thread may be using the map. Tables retired through a
+ *       reclamation domain are freed by the domain.
+ */
+static_inline void hashmap_destroy(
+    Hashmap *const map
+) {
+    Hashmap_Table* table = (Hashmap_Table*)atomic_load_uintptr(
+        &map->retired
+    );
+
+    while (table) {
+        Hashmap_Table *const prev = table->prev;
+        free(table);
+        table = prev;
+    }
+    free((void*)atomic_load_uintptr(&map->table));
+    atomic_store_uintptr(&map->table, 0);
+}
+
+/**
+ * @brief Looks up a key.
+ * 
+ * @note Lock-free and, apart from the caller's own reclamation record,
+ *       never writes to memory, so lookups from any number of threads don't
+ *       contend with each other.
+ * 
+ * @returns The key's value; 0 if absent.
+ */
+static_inline uintptr_t hashmap_get(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    uintptr_t key
+) {
+    uint32_t const hash = __hashmap_hash(key);
+    uintptr_t value = __HASHMAP_EMPTY;
+    Hashmap_Table* table;
+
+    if (thread)
+        reclaim_ebr_enter(thread);
+
+    table = (Hashmap_Table*)atomic_load_uintptr(&map->table);
+    while (table) {
+        uintptr_t found;
+        Hashmap_Slot *const slot = __hashmap_find(table, key, hash, &found);
+
+        if (found == key) {
+            if ((value = atomic_load_uintptr(&slot->value)) != __HASHMAP_MOVED)
+                break;
+        } else if (found == __HASHMAP_EMPTY) {
+            break;
+        }
+
+        /* moved or sealed: the key can only be in the next table */
+        value = __HASHMAP_EMPTY;
+        table = (Hashmap_Table*)atomic_load_uintptr(&table->next);
+    }
+
+    if (thread)
+        reclaim_ebr_exit(thread);
+    return value == __HASHMAP_TOMB ? __HASHMAP_EMPTY : value;
+}
+
+/* shared by every write: swaps a key's value, resizing on the way */
+static_inline bool __hashmap_write(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    uintptr_t key,
+    uintptr_t value,
+    bool replace,
+    uintptr_t *const previous
+) {
+    uint32_t const hash = __hashmap_hash(key);
+    Hashmap_Table* retire = NULL;
+    Hashmap_Table* table;
+    uintptr_t current = __HASHMAP_EMPTY;
+    bool claim = (value != __HASHMAP_TOMB), result = true;
+
+    if (thread)
+        reclaim_ebr_enter(thread);
+
+    table = (Hashmap_Table*)atomic_load_uintptr(&map->table);
+    for (;;) {
+        Hashmap_Table* next = (Hashmap_Table*)atomic_load_uintptr(
+            &table->next
+        );
+        Hashmap_Slot* slot;
+        uintptr_t found;
+
+        if (next)
+            __hashmap_help(map, table, next, &retire);
+        slot = __hashmap_find(table, key, hash, &found);
+
+        if (found == __HASHMAP_EMPTY && claim && !next) {
+            /* new keys wait out any copy into this table, so it can't fill */
+            if (atomic_load_uintptr(&map->table) != (uintptr_t)table) {
+                __hashmap_settle(map, table, &retire);
+                continue;
+            }
+
+            /* reserve room first, so the table never fills past half */
+            if (atomic_fetch_add_uint32(&table->used, 1) <
+                    (table->mask + 1) / 2) {
+                if (!atomic_compare_exchange_strong_uintptr(
+                    &slot->key, &found, key
+                ))
+                    atomic_fetch_sub_uint32(&table->used, 1);
+                continue;
+            }
+
+            atomic_fetch_sub_uint32(&table->used, 1);
+            if (!(next = __hashmap_grow(map, table, &retire))) {
+                result = false;
+                break;
+            }
+        }
+
+        if (found == __HASHMAP_EMPTY) {
+            if (!claim)
+                break;  /* removing a key which isn't there */
+
+            /* close the probe, so the key can't land here behind the copy */
+            if (atomic_compare_exchange_strong_uintptr(
+                &slot->key, &found, __HASHMAP_SEALED
+            ))
+                table = next;
+            continue;
+        } else if (found != key) {
+            /* sealed or full: the key can only be in the next table */
+            if (!next) {
+                next = claim ? __hashmap_grow(map, table, &retire) :
+                    (Hashmap_Table*)atomic_load_uintptr(&table->next);
+            }
+            if (!next) {
+                result = !claim;
+                break;
+            }
+            table = next;
+            continue;
+        }
+
+        current = atomic_load_uintptr(&slot->value);
+        while (current != __HASHMAP_MOVED) {
+            if (!replace &&
+                current != __HASHMAP_EMPTY && current != __HASHMAP_TOMB)
+                break;
+            if (atomic_compare_exchange_weak_uintptr(
+                &slot->value, &current, value
+            ))
+                break;
+        }
+        if (current != __HASHMAP_MOVED)
+            break;
+        table = next ? next : (Hashmap_Table*)atomic_load_uintptr(
+            &table->next
+        );
+    }
+
+    if (thread)
+        reclaim_ebr_exit(thread);
+    while (retire) {
+        Hashmap_Table *const prev = retire->prev;
+        __hashmap_retire(map, thread, retire);
+        retire = prev;
+    }
+
+    if (previous) {
+        *previous = (
+            current == __HASHMAP_TOMB || current == __HASHMAP_MOVED
+        ) ? __HASHMAP_EMPTY : current;
+    }
+    return result;
+}
+
+/**
+ * @brief Sets a key's value.
+ * 
+ * @param[in,out] map      The map to write to.
+ * @param[in,out] thread   The caller's reclamation record, or @c NULL.
+ * @param[in]     key      A nonzero key.
+ * @param[in]     value    A valid value (see @c Hashmap).
+ * @param[out]    previous The value replaced, or 0; may be @c NULL.
+ * 
+ * @note Lock-free, except that adding a new key during a resize helps copy
+ *       the table and then waits for chunks other threads are copying.
+ * 
+ * @returns @c true on success; @c false if a resize ran out of memory.
+ */
+static_inline bool hashmap_put(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    uintptr_t key,
+    uintptr_t value,
+    uintptr_t *const previous
+) {
+    return __hashmap_write(map, thread, key, value, true, previous);
+}
+
+/**
+ * @brief Sets a key's value only if it has none.
+ * 
+ * @param[out] existing The value already present, or 0 if @e value was
+ *                      inserted; may be @c NULL.
+ * 
+ * @returns @c true on success; @c false if a resize ran out of memory.
+ */
+static_inline bool hashmap_insert(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    uintptr_t key,
+    uintptr_t value,
+    uintptr_t *const existing
+) {
+    return __hashmap_write(map, thread, key, value, false, existing);
+}
+
+/**
+ * @brief Removes a key.
+ * 
+ * @note A removed key keeps its slot until the next resize.
+ * 
+ * @returns The value removed; 0 if the key was absent.
+ */
+static_inline uintptr_t hashmap_remove(
+    Hashmap *const map,
+    Reclaim_Thread *const thread,
+    uintptr_t key
+) {
+    uintptr_t previous;
+    __hashmap_write(map, thread, key, __HASHMAP_TOMB, true, &previous);
+    return previous;
+}
+
+#endif /* HASHMAP_H_ */
@@ -4432,7 +4432,7 @@
 
 #if defined(__linux__) && !defined(MACRODEFS_ONLY)
 #   include <asm/types.h>
-#   define WORD_SIZE BITS_PER_LONG
+#   define WORD_SIZE __BITS_PER_LONG
 #elif defined __WORDSIZE
 #   define WORD_SIZE __WORDSIZE
 #elif defined(__aarch64__) || defined(__x86_64__) || defined(__ia64__) \
@@ -5174,6 +5174,120 @@
 #   undef BSWAP64
 #endif
 
+/* == BIT SCAN OPERATIONS =================================================== */
+
+/**
+ * @def CTZ32(x)
+ * @brief Counts the trailing zero bits of a non-zero 32-bit integral value.
+ * 
+ * @param[in] x A non-zero 32-bit number.
+ * 
+ * @returns The index of the lowest set bit in @e x.
+ */
+/**
+ * @def CTZ64(x)
+ * @brief Counts the trailing zero bits of a non-zero 64-bit integral value.
+ * 
+ * @param[in] x A non-zero 64-bit number.
+ * 
+ * @returns The index of the lowest set bit in @e x.
+ */
+/**
+ * @def CLZ32(x)
+ * @brief Counts the leading zero bits of a non-zero 32-bit integral value.
+ * 
+ * @param[in] x A non-zero 32-bit number.
+ * 
+ * @returns 31 minus the index of the highest set bit in @e x.
+ */
+/**
+ * @def CLZ64(x)
+ * @brief Counts the leading zero bits of a non-zero 64-bit integral value.
+ * 
+ * @param[in] x A non-zero 64-bit number.
+ * 
+ * @returns 63 minus the index of the highest set bit in @e x.
+ */
+#if (__has_builtin(__builtin_ctz) && __has_builtin(__builtin_clz)) || \
+    GCC_PREREQ(30400)
+#   define CTZ32(x) ((unsigned)__builtin_ctz((uint32_t)(x)))
+#   define CLZ32(x) ((unsigned)__builtin_clz((uint32_t)(x)))
+#   define CTZ64(x) ((unsigned)__builtin_ctzll((uint64_t)(x)))
+#   define CLZ64(x) ((unsigned)__builtin_clzll((uint64_t)(x)))
+#elif defined(_MSC_VER) /* MSVC bit scan intrinsics */
+#   include <intrin.h>
+    static_force_inline unsigned __macrodefs_ctz32(uint32_t x) {
+        unsigned long i;
+        _BitScanForward(&i, x);
+        return (unsigned)i;
+    }
+    static_force_inline unsigned __macrodefs_clz32(uint32_t x) {
+        unsigned long i;
+        _BitScanReverse(&i, x);
+        return 31 - (unsigned)i;
+    }
+    static_force_inline unsigned __macrodefs_ctz64(uint64_t x) {
+#   if defined(_M_X64) || defined(_M_ARM64)
+        unsigned long i;
+        _BitScanForward64(&i, x);
+        return (unsigned)i;
+#   else
+        return (uint32_t)x ? __macrodefs_ctz32((uint32_t)x) :
+            32 + __macrodefs_ctz32((uint32_t)(x >> 32));
+#   endif
+    }
+    static_force_inline unsigned __macrodefs_clz64(uint64_t x) {
+#   if defined(_M_X64) || defined(_M_ARM64)
+        unsigned long i;
+        _BitScanReverse64(&i, x);
+        return 63 - (unsigned)i;
+#   else
+        return (uint32_t)(x >> 32) ? __macrodefs_clz32((uint32_t)(x >> 32)) :
+            32 + __macrodefs_clz32((uint32_t)x);
+#   endif
+    }
+#   define CTZ32(x) __macrodefs_ctz32(x)
+#   define CLZ32(x) __macrodefs_clz32(x)
+#   define CTZ64(x) __macrodefs_ctz64(x)
+#   define CLZ64(x) __macrodefs_clz64(x)
+#else /* manual fallback */
+    static_force_inline unsigned __macrodefs_ctz32(uint32_t x) {
+        static unsigned char const table[32] = {
+             0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+            31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+        };
+        return table[(uint32_t)((x & (0 - x)) * 0x077cb531U) >> 27];
+    }
+    static_force_inline unsigned __macrodefs_clz32(uint32_t x) {
+        unsigned n = 0;
+        if (!(x & 0xffff0000U)) { n += 16; x <<= 16; }
+        if (!(x & 0xff000000U)) { n += 8; x <<= 8; }
+        if (!(x & 0xf0000000U)) { n += 4; x <<= 4; }
+        if (!(x & 0xc0000000U)) { n += 2; x <<= 2; }
+        if (!(x & 0x80000000U)) { n += 1; }
+        return n;
+    }
+#   ifdef _INT64_DEFINED
+        static_force_inline unsigned __macrodefs_ctz64(uint64_t x) {
+            return (uint32_t)x ? __macrodefs_ctz32((uint32_t)x) :
+                32 + __macrodefs_ctz32((uint32_t)(x >> 32));
+        }
+        static_force_inline unsigned __macrodefs_clz64(uint64_t x) {
+            return (uint32_t)(x >> 32) ?
+                __macrodefs_clz32((uint32_t)(x >> 32)) :
+                32 + __macrodefs_clz32((uint32_t)x);
+        }
+#   endif
+#   define CTZ32(x) __macrodefs_ctz32(x)
+#   define CLZ32(x) __macrodefs_clz32(x)
+#   define CTZ64(x) __macrodefs_ctz64(x)
+#   define CLZ64(x) __macrodefs_clz64(x)
+#endif
+#ifndef _INT64_DEFINED
+#   undef CTZ64
+#   undef CLZ64
+#endif
+
 /* == BYTE ORDER MACROS AND HOST-TO-ENDIAN-AND-BACK OPERATIONS ============== */
 
 /**
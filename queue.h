@@ -0,0 +1,431 @@
+/**
+ * @file queue.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Concurrent queues specialized for how many threads sit on each end.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+#ifdef QUEUE_USE_BLOCKING
+#   include "thread.h"
+#endif
+#if CPP_PREREQ(1L)
+#   include <cstdlib>
+#   include <cstring>
+#else
+#   include <stdlib.h>
+#   include <string.h>
+#endif
+
+#ifndef QUEUE_CACHE_LINE
+#   define QUEUE_CACHE_LINE 64
+#endif /* !QUEUE_CACHE_LINE */
+
+/* == SINGLE-PRODUCER SINGLE-CONSUMER RINGS ================================= */
+
+/**
+ * @brief A bounded ring buffer of fixed-size elements between exactly one
+ *        producer thread and one consumer thread.
+ * 
+ * @note Each side writes only its own index, on its own cache line, and
+ *       keeps a private copy of the other side's index which it refreshes
+ *       only when the ring looks full or empty. Every push or pop, however
+ *       many elements it moves, publishes them with a single store.
+ * 
+ * @note Define @c QUEUE_USE_BLOCKING to add @c queue_spsc_push_wait and
+ *       @c queue_spsc_pop_wait, which sleep on @c thread.h semaphores. The
+ *       semaphores are only touched when a side actually has to sleep.
+ */
+typedef struct Queue_Spsc {
+    uint8_t* buffer;
+    size_t size;
+    uint32_t mask;
+    uint8_t pad0[QUEUE_CACHE_LINE];
+
+    /* written by the producer */
+    atomic_uint32 tail;
+    uint32_t head_cache;
+#ifdef QUEUE_USE_BLOCKING
+    atomic_uint32 push_waiting;
+#endif
+    uint8_t pad1[QUEUE_CACHE_LINE];
+
+    /* written by the consumer */
+    atomic_uint32 head;
+    uint32_t tail_cache;
+#ifdef QUEUE_USE_BLOCKING
+    atomic_uint32 pop_waiting;
+#endif
+    uint8_t pad2[QUEUE_CACHE_LINE];
+
+#ifdef QUEUE_USE_BLOCKING
+    sem_t items, slots;
+#endif
+} Queue_Spsc;
+
+/**
+ * @brief Initializes an empty ring.
+ * 
+ * @param[out] queue    The ring to initialize.
+ * @param[in]  capacity Number of elements; rounded up to a power of two, at
+ *                      most 2^31.
+ * @param[in]  size     Size of each element in bytes.
+ * 
+ * @returns @c true on success; @c false if out of memory or out of range.
+ */
+static_inline bool queue_spsc_init(
+    Queue_Spsc *const queue,
+    uint32_t capacity,
+    size_t size
+) {
+    uint32_t count = 1;
+
+    if (!size || capacity > UINT32_C(0x80000000))
+        return false;
+    while (count < capacity)
+        count <<= 1;
+
+    if (!(queue->buffer = (uint8_t*)malloc((size_t)count * size)))
+        return false;
+#ifdef QUEUE_USE_BLOCKING
+    if (sem_init(&queue->items, 0, 0) != 0) {
+        free(queue->buffer);
+        return false;
+    } else if (sem_init(&queue->slots, 0, 0) != 0) {
+        sem_destroy(&queue->items);
+        free(queue->buffer);
+        return false;
+    }
+    atomic_store_uint32(&queue->push_waiting, 0);
+    atomic_store_uint32(&queue->pop_waiting, 0);
+#endif
+
+    queue->size = size;
+    queue->mask = count - 1;
+    atomic_store_uint32(&queue->tail, 0);
+    atomic_store_uint32(&queue->head, 0);
+    queue->head_cache = 0;
+    queue->tail_cache = 0;
+    return true;
+}
+
+/**
+ * @brief Frees a ring's storage. Elements still queued are dropped.
+ */
+static_inline void queue_spsc_destroy(
+    Queue_Spsc *const queue
+) {
+#ifdef QUEUE_USE_BLOCKING
+    sem_destroy(&queue->items);
+    sem_destroy(&queue->slots);
+#endif
+    free(queue->buffer);
+    queue->buffer = NULL;
+}
+
+/* copies count elements between a ring slot index and a flat array */
+static_inline void __queue_spsc_copy(
+    Queue_Spsc const *const queue,
+    uint32_t index,
+    void *const dst,
+    void const *const src,
+    uint32_t count,
+    bool into_ring
+) {
+    uint32_t const first = (index & queue->mask);
+    uint32_t const run = MIN(count, queue->mask + 1 - first);
+    uint8_t* const slot = queue->buffer + first * queue->size;
+    size_t const head_bytes = run * queue->size;
+    size_t const tail_bytes = (count - run) * queue->size;
+
+    if (into_ring) {
+        memcpy(slot, src, head_bytes);
+        memcpy(queue->buffer, (uint8_t const*)src + head_bytes, tail_bytes);
+    } else {
+        memcpy(dst, slot, head_bytes);
+        memcpy((uint8_t*)dst + head_bytes, queue->buffer, tail_bytes);
+    }
+}
+
+/**
+ * @brief Appends up to @e count elements. Only the producer may call this.
+ * 
+ * @returns How many elements were pushed; fewer than @e count if the ring
+ *          filled up.
+ */
+static_inline uint32_t queue_spsc_push(
+    Queue_Spsc *const queue,
+    void const *const items,
+    uint32_t count
+) {
+    uint32_t const tail = atomic_load_uint32(&queue->tail);
+    uint32_t free_slots = queue->mask + 1 - (tail - queue->head_cache);
+
+    if (free_slots < count) {
+        queue->head_cache = atomic_load_uint32(&queue->head);
+        free_slots = queue->mask + 1 - (tail - queue->head_cache);
+    }
+    if (!(count = MIN(count, free_slots)))
+        return 0;
+
+    __queue_spsc_copy(queue, tail, NULL, items, count, true);
+    atomic_store_uint32(&queue->tail, tail + count);
+#ifdef QUEUE_USE_BLOCKING
+    if UNLIKELY(atomic_load_uint32(&queue->pop_waiting)) {
+        if (atomic_exchange_uint32(&queue->pop_waiting, 0))
+            sem_post(&queue->items);
+    }
+#endif
+    return count;
+}
+
+/**
+ * @brief Removes up to @e count elements. Only the consumer may call this.
+ * 
+ * @returns How many elements were popped into @e items; 0 if empty.
+ */
+static_inline uint32_t queue_spsc_pop(
+    Queue_Spsc *const queue,
+    void *const items,
+    uint32_t count
+) {
+    uint32_t const head = atomic_load_uint32(&queue->head);
+    uint32_t used = queue->tail_cache - head;
+
+    if (used < count) {
+        queue->tail_cache = atomic_load_uint32(&queue->tail);
+        used = queue->tail_cache - head;
+    }
+    if (!(count = MIN(count, used)))
+        return 0;
+
+    __queue_spsc_copy(queue, head, items, NULL, count, false);
+    atomic_store_uint32(&queue->head, head + count);
+#ifdef QUEUE_USE_BLOCKING
+    if UNLIKELY(atomic_load_uint32(&queue->push_waiting)) {
+        if (atomic_exchange_uint32(&queue->push_waiting, 0))
+            sem_post(&queue->slots);
+    }
+#endif
+    return count;
+}
+
+#ifdef QUEUE_USE_BLOCKING
+
+/**
+ * @brief Appends all @e count elements, sleeping whenever the ring is full.
+ */
+static_inline void queue_spsc_push_wait(
+    Queue_Spsc *const queue,
+    void const* items,
+    uint32_t count
+) {
+    while (count) {
+        uint32_t pushed = queue_spsc_push(queue, items, count);
+
+        if (!pushed) {
+            /* announce before rechecking so the consumer can't miss us */
+            atomic_store_uint32(&queue->push_waiting, 1);
+            if (!(pushed = queue_spsc_push(queue, items, count))) {
+                sem_wait(&queue->slots);
+                continue;
+            }
+            atomic_store_uint32(&queue->push_waiting, 0);
+        }
+
+        items = (uint8_t const*)items + pushed * queue->size;
+        count -= pushed;
+    }
+}
+
+/**
+ * @brief Removes between 1 and @e count elements, sleeping while the ring is
+ *        empty.
+ * 
+ * @returns How many elements were popped into @e items.
+ */
+static_inline uint32_t queue_spsc_pop_wait(
+    Queue_Spsc *const queue,
+    void *const items,
+    uint32_t count
+) {
+    uint32_t popped;
+
+    while (!(popped = queue_spsc_pop(queue, items, count))) {
+        atomic_store_uint32(&queue->pop_waiting, 1);
+        if ((popped = queue_spsc_pop(queue, items, count))) {
+            atomic_store_uint32(&queue->pop_waiting, 0);
+            break;
+        }
+        sem_wait(&queue->items);
+    }
+    return popped;
+}
+
+#endif /* QUEUE_USE_BLOCKING */
+
+/* == MULTI-PRODUCER SINGLE-CONSUMER QUEUES ================================= */
+
+/**
+ * @brief A link embedded in each element of a @c Queue_Mpsc.
+ * 
+ * @note Get back to the element with @c CONTAINER_OF:
+ * @code
+ * typedef struct Message {
+ *     Queue_Mpsc_Node link;
+ *     int payload;
+ * } Message;
+ * 
+ * Queue_Mpsc_Node* node = queue_mpsc_pop(&mailbox);
+ * if (node)
+ *     handle(CONTAINER_OF(node, Message, link));
+ * @endcode
+ */
+typedef struct Queue_Mpsc_Node {
+    atomic_uintptr next;
+} Queue_Mpsc_Node;
+
+/**
+ * @brief An unbounded intrusive FIFO which any thread may push onto and one
+ *        thread pops from.
+ * 
+ * @note Dmitry Vyukov's algorithm. A push is one exchange and one store, and
+ *       never loops or allocates; a pop is plain loads and stores except
+ *       when it takes the last element.
+ * 
+ * @note A producer preempted between its two steps hides its element, and
+ *       any pushed after it, until it resumes; pops report empty meanwhile.
+ */
+typedef struct Queue_Mpsc {
+    atomic_uintptr tail;
+    uint8_t pad0[QUEUE_CACHE_LINE];
+
+    /* only touched by the consumer */
+    Queue_Mpsc_Node* head;
+    Queue_Mpsc_Node stub;
+} Queue_Mpsc;
+
+/**
+ * @brief Initializes an empty queue.
+ */
+static_inline void queue_mpsc_init(
+    Queue_Mpsc *const queue
+) {
+    atomic_store_uintptr(&queue->stub.next, 0);
+    atomic_store_uintptr(&queue->tail, (uintptr_t)&queue->stub);
+    queue->head = &queue->stub;
+}
+
+/**
+ * @brief Appends an element. Safe to call from any number of threads.
+ * 
+ * @param[in,out] queue The queue to push onto.
+ * @param[in,out] node  The element's link; owned by the queue until popped.
+ */
+static_inline void queue_mpsc_push(
+    Queue_Mpsc *const queue,
+    Queue_Mpsc_Node *const node
+) {
+    Queue_Mpsc_Node* prev;
+
+    atomic_store_uintptr(&node->next, 0);
+    prev = (Queue_Mpsc_Node*)atomic_exchange_uintptr(
+        &queue->tail, (uintptr_t)node
+    );
+    atomic_store_uintptr(&prev->next, (uintptr_t)node);
+}
+
+/**
+ * @brief Removes the oldest element. Only the consumer may call this.
+ * 
+ * @returns The element's link; @c NULL if the queue is empty.
+ */
+static_inline Queue_Mpsc_Node* queue_mpsc_pop(
+    Queue_Mpsc *const queue
+) {
+    Queue_Mpsc_Node* head = queue->head;
+    Queue_Mpsc_Node* next = (Queue_Mpsc_Node*)atomic_load_uintptr(
+        &head->next
+    );
+
+    if (head == &queue->stub) {
+        if (!next)
+            return NULL;
+        queue->head = head = next;
+        next = (Queue_Mpsc_Node*)atomic_load_uintptr(&next->next);
+    }
+    if (next) {
+        queue->head = next;
+        return head;
+    }
+
+    /* head is the last linked element; only take it if it's also the tail */
+    if ((uintptr_t)head != atomic_load_uintptr(&queue->tail))
+        return NULL;
+    queue_mpsc_push(queue, &queue->stub);
+    if ((next = (Queue_Mpsc_Node*)atomic_load_uintptr(&head->next))) {
+        queue->head = next;
+        return head;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Removes every element currently linked into the queue. Only the
+ *        consumer may call this.
+ * 
+ * @note The elements are returned oldest first, chained through their
+ *       links; walk them with @c queue_mpsc_next. Only elements queued when
+ *       the call starts are taken, so it returns even under sustained
+ *       pushes; elements pushed meanwhile stay queued.
+ * 
+ * @note The producers' links already chain the elements in order, so only
+ *       the one skipping the queue's internal stub and the last one are
+ *       rewritten, rather than every element.
+ * 
+ * @returns The oldest element's link; @c NULL if the queue is empty.
+ */
+static_inline Queue_Mpsc_Node* queue_mpsc_pop_all(
+    Queue_Mpsc *const queue
+) {
+    Queue_Mpsc_Node *const tail = (Queue_Mpsc_Node*)atomic_load_uintptr(
+        &queue->tail
+    );
+    Queue_Mpsc_Node* first, *last, *node;
+
+    if (tail == &queue->stub && queue->head == &queue->stub)
+        return NULL;
+    if (!(first = last = queue_mpsc_pop(queue)))
+        return NULL;
+
+    /* stop at the tail seen on entry, or at the stub if that was it */
+    while (last != tail && !(
+        tail == &queue->stub && queue->head == &queue->stub
+    ) && (node = queue_mpsc_pop(queue))) {
+        if (atomic_load_uintptr(&last->next) != (uintptr_t)node)
+            atomic_store_uintptr(&last->next, (uintptr_t)node);
+        last = node;
+    }
+    atomic_store_uintptr(&last->next, 0);
+    return first;
+}
+
+/**
+ * @brief Steps through a list returned by @c queue_mpsc_pop_all.
+ * 
+ * @returns The next element's link; @c NULL after the last one.
+ */
+static_inline Queue_Mpsc_Node* queue_mpsc_next(
+    Queue_Mpsc_Node const *const node
+) {
+    return (Queue_Mpsc_Node*)atomic_load_uintptr(&node->next);
+}
+
+#endif /* QUEUE_H_ */
@@ -0,0 +1,462 @@
+/**
+ * @file reclaim.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Safe memory reclamation for lock-free data structures, via hazard
+ *        pointers or epochs.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef RECLAIM_H_
+#define RECLAIM_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+#include "thread.h"
+#if CPP_PREREQ(1L)
+#   include <cstdlib>
+#else
+#   include <stdlib.h>
+#endif
+
+#ifndef RECLAIM_HAZARDS
+#   define RECLAIM_HAZARDS 4
+#endif /* !RECLAIM_HAZARDS */
+
+#ifndef RECLAIM_BATCH
+#   define RECLAIM_BATCH 64
+#endif /* !RECLAIM_BATCH */
+
+/* == DOMAINS =============================================================== */
+
+/**
+ * @brief Function called to free a retired pointer once no reader can still
+ *        hold it.
+ */
+typedef void (CDECL* Reclaim_Free)(void* ptr);
+
+/**
+ * @brief A pointer waiting to be freed.
+ */
+typedef struct Reclaim_Retired {
+    void* ptr;
+    Reclaim_Free free;
+    uint64_t epoch;     /**< Global epoch when retired; unused by hazards. */
+} Reclaim_Retired;
+
+typedef struct Reclaim_Domain Reclaim_Domain;
+
+/**
+ * @brief A thread's record in a domain.
+ * 
+ * @note Records are never unlinked while their domain lives. When a thread
+ *       exits, its record is released for the next thread to adopt, along
+ *       with whatever it had retired but not yet freed.
+ */
+typedef struct Reclaim_Thread {
+    atomic_uintptr hazards[RECLAIM_HAZARDS];
+    atomic_uint64 epoch;    /**< Epoch entered, shifted left; low bit set
+                                 while inside a read-side section. */
+    atomic_uint32 in_use;
+    unsigned depth;
+
+    struct Reclaim_Thread* next;
+    Reclaim_Domain* domain;
+
+    Reclaim_Retired* hp;
+    size_t hp_count, hp_cap;
+    Reclaim_Retired* ebr;
+    size_t ebr_count, ebr_cap;
+    uintptr_t* scratch;
+    size_t scratch_cap;
+} Reclaim_Thread;
+
+/**
+ * @brief A set of threads sharing lock-free structures.
+ * 
+ * @note The lock is only taken to register a thread's first record; reading
+ *       and retiring never block.
+ */
+struct Reclaim_Domain {
+    atomic_uintptr threads;     /**< Most recently registered record. */
+    atomic_uint32 count;        /**< Number of records. */
+    atomic_uint64 epoch;
+    mtx_t lock;
+    tss_t key;
+};
+
+static_inline void CDECL __reclaim_thread_exit(void* p) {
+    Reclaim_Thread *const thread = (Reclaim_Thread*)p;
+    unsigned i;
+
+    for (i = 0; i < RECLAIM_HAZARDS; ++i)
+        atomic_store_uintptr(&thread->hazards[i], 0);
+    thread->depth = 0;
+    atomic_store_uint64(&thread->epoch, 0);
+    atomic_store_uint32(&thread->in_use, 0);
+}
+
+/**
+ * @brief Initializes a reclamation domain.
+ * 
+ * @returns @c true on success; @c false if no thread-specific storage key
+ *          could be created.
+ */
+static_inline bool reclaim_domain_init(
+    Reclaim_Domain *const domain
+) {
+    atomic_store_uintptr(&domain->threads, 0);
+    atomic_store_uint32(&domain->count, 0);
+    atomic_store_uint64(&domain->epoch, 0);
+    if (tss_create(&domain->key, __reclaim_thread_exit) != thrd_success)
+        return false;
+    if (mtx_init(&domain->lock, mtx_plain) != thrd_success) {
+        tss_delete(domain->key);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Frees everything still retired in a domain, then the domain's
+ *        thread records.
+ * 
+ * @note No other thread may be using the domain.
+ */
+static_inline void reclaim_domain_destroy(
+    Reclaim_Domain *const domain
+) {
+    Reclaim_Thread* thread = (Reclaim_Thread*)atomic_load_uintptr(
+        &domain->threads
+    );
+
+    while (thread) {
+        Reclaim_Thread *const next = thread->next;
+        size_t i;
+
+        for (i = 0; i < thread->hp_count; ++i)
+            thread->hp[i].free(thread->hp[i].ptr);
+        for (i = 0; i < thread->ebr_count; ++i)
+            thread->ebr[i].free(thread->ebr[i].ptr);
+        free(thread->hp);
+        free(thread->ebr);
+        free(thread->scratch);
+        free(thread);
+        thread = next;
+    }
+
+    tss_delete(domain->key);
+    mtx_destroy(&domain->lock);
+}
+
+static_inline Reclaim_Thread* __reclaim_thread_acquire(
+    Reclaim_Domain *const domain
+) {
+    Reclaim_Thread* thread = (Reclaim_Thread*)atomic_load_uintptr(
+        &domain->threads
+    );
+
+    /* adopt a record left behind by a thread which has exited */
+    for (; thread; thread = thread->next) {
+        uint32_t expected = 0;
+        if (atomic_compare_exchange_strong_uint32(
+            &thread->in_use, &expected, 1
+        ))
+            break;
+    }
+
+    if (!thread) {
+        if (!(thread = (Reclaim_Thread*)calloc(1, sizeof(*thread))))
+            return NULL;
+        atomic_store_uint32(&thread->in_use, 1);
+        thread->domain = domain;
+
+        mtx_lock(&domain->lock);
+        thread->next = (Reclaim_Thread*)atomic_load_uintptr(
+            &domain->threads
+        );
+        atomic_store_uintptr(&domain->threads, (uintptr_t)thread);
+        atomic_fetch_add_uint32(&domain->count, 1);
+        mtx_unlock(&domain->lock);
+    }
+
+    tss_set(domain->key, thread);
+    return thread;
+}
+
+/**
+ * @brief Gets the calling thread's record in a domain, registering it on
+ *        first use.
+ * 
+ * @note This costs a thread-specific storage lookup; hot paths should keep
+ *       the record rather than asking for it on every operation.
+ * 
+ * @returns The record; @c NULL if a new one couldn't be allocated.
+ */
+static_inline Reclaim_Thread* reclaim_thread(
+    Reclaim_Domain *const domain
+) {
+    Reclaim_Thread *const thread = (Reclaim_Thread*)tss_get(domain->key);
+    if LIKELY(thread != NULL)
+        return thread;
+    return __reclaim_thread_acquire(domain);
+}
+
+/* grows a retire list, or returns false if it can't */
+static_inline bool __reclaim_reserve(
+    Reclaim_Retired** list,
+    size_t *const cap,
+    size_t count
+) {
+    Reclaim_Retired* grown;
+    size_t size;
+
+    if (count < *cap)
+        return true;
+
+    size = *cap ? *cap * 2 : RECLAIM_BATCH * 2;
+    if (!(grown = (Reclaim_Retired*)realloc(*list, size * sizeof(**list))))
+        return false;
+    *list = grown;
+    *cap = size;
+    return true;
+}
+
+/* == HAZARD POINTERS ======================================================= */
+
+/**
+ * @brief Loads a shared pointer and protects it from being freed.
+ * 
+ * @param[in,out] thread The calling thread's record.
+ * @param[in]     slot   Which of the thread's @c RECLAIM_HAZARDS hazard
+ *                       pointers to use.
+ * @param[in]     src    The shared pointer to load.
+ * 
+ * @note The pointer stays safe to dereference until the slot is cleared or
+ *       reused, however long that takes; in exchange, every load costs a
+ *       store and a re-load to confirm it.
+ * 
+ * @returns The value of @e src, as protected.
+ */
+static_inline uintptr_t reclaim_hp_protect(
+    Reclaim_Thread *const thread,
+    unsigned slot,
+    atomic_uintptr volatile* src
+) {
+    uintptr_t p = atomic_load_uintptr(src), q;
+
+    for (;;) {
+        atomic_store_uintptr(&thread->hazards[slot], p);
+        if ((q = atomic_load_uintptr(src)) == p)
+            return p;
+        p = q;
+    }
+}
+
+/**
+ * @brief Drops the protection held by a hazard pointer.
+ */
+static_inline void reclaim_hp_clear(
+    Reclaim_Thread *const thread,
+    unsigned slot
+) {
+    atomic_store_uintptr(&thread->hazards[slot], 0);
+}
+
+static_inline int CDECL __reclaim_compare(void const* a, void const* b) {
+    uintptr_t x = *(uintptr_t const*)a, y = *(uintptr_t const*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Frees every pointer the calling thread has retired through hazard
+ *        pointers which no thread still protects.
+ */
+static_inline void reclaim_hp_scan(
+    Reclaim_Thread *const thread
+) {
+    Reclaim_Thread *const head = (Reclaim_Thread*)atomic_load_uintptr(
+        &thread->domain->threads
+    );
+    size_t need = 0, hazards = 0, kept = 0, i;
+    Reclaim_Thread* other;
+
+    /* records registered after the head was read can't hold anything
+     * retired before it, so they're skipped */
+    for (other = head; other; other = other->next)
+        need += RECLAIM_HAZARDS;
+    if (need > thread->scratch_cap) {
+        uintptr_t *const grown = (uintptr_t*)realloc(
+            thread->scratch, need * sizeof(uintptr_t)
+        );
+        if (!grown)
+            return;
+        thread->scratch = grown;
+        thread->scratch_cap = need;
+    }
+
+    for (other = head; other; other = other->next) {
+        for (i = 0; i < RECLAIM_HAZARDS; ++i) {
+            uintptr_t p = atomic_load_uintptr(&other->hazards[i]);
+            if (p)
+                thread->scratch[hazards++] = p;
+        }
+    }
+    qsort(thread->scratch, hazards, sizeof(uintptr_t), __reclaim_compare);
+
+    for (i = 0; i < thread->hp_count; ++i) {
+        Reclaim_Retired *const r = &thread->hp[i];
+        uintptr_t p = (uintptr_t)r->ptr;
+
+        if (hazards && bsearch(
+            &p, thread->scratch, hazards, sizeof(uintptr_t),
+            __reclaim_compare
+        ))
+            thread->hp[kept++] = *r;
+        else
+            r->free(r->ptr);
+    }
+    thread->hp_count = kept;
+}
+
+/**
+ * @brief Retires a pointer already unlinked from every shared structure, to
+ *        be freed once no hazard pointer protects it.
+ * 
+ * @note Pointers are collected in batches; a scan runs once the batch
+ *       outgrows @c RECLAIM_BATCH plus twice the number of hazard pointers,
+ *       so each scan frees at least half of it and memory stays bounded.
+ */
+static_inline void reclaim_hp_retire(
+    Reclaim_Thread *const thread,
+    void* ptr,
+    Reclaim_Free free_fn
+) {
+    size_t limit;
+
+    while UNLIKELY(!__reclaim_reserve(
+        &thread->hp, &thread->hp_cap, thread->hp_count
+    )) {
+        reclaim_hp_scan(thread);
+        if (thread->hp_count < thread->hp_cap)
+            break;
+        thrd_yield();
+    }
+
+    thread->hp[thread->hp_count].ptr = ptr;
+    thread->hp[thread->hp_count].free = free_fn;
+    thread->hp[thread->hp_count].epoch = 0;
+
+    limit = RECLAIM_BATCH + 2 * RECLAIM_HAZARDS *
+        (size_t)atomic_load_uint32(&thread->domain->count);
+    if (++thread->hp_count >= limit)
+        reclaim_hp_scan(thread);
+}
+
+/* == EPOCHS ================================================================ */
+
+/**
+ * @brief Starts a read-side section; pointers loaded inside it stay valid
+ *        until the matching @c reclaim_ebr_exit.
+ * 
+ * @note Sections nest. Entering and exiting costs one store each, with no
+ *       per-pointer work, but a thread stalled inside a section holds back
+ *       every pointer retired after it entered.
+ */
+static_inline void reclaim_ebr_enter(
+    Reclaim_Thread *const thread
+) {
+    if (!thread->depth++) {
+        uint64_t epoch = atomic_load_uint64(&thread->domain->epoch);
+        atomic_store_uint64(&thread->epoch, epoch << 1 | 1);
+    }
+}
+
+/**
+ * @brief Ends a read-side section.
+ */
+static_inline void reclaim_ebr_exit(
+    Reclaim_Thread *const thread
+) {
+    if (!--thread->depth)
+        atomic_store_uint64(&thread->epoch, 0);
+}
+
+/* moves the global epoch on if every thread inside a section has seen it */
+static_inline uint64_t __reclaim_ebr_advance(
+    Reclaim_Domain *const domain
+) {
+    uint64_t epoch = atomic_load_uint64(&domain->epoch);
+    Reclaim_Thread* thread = (Reclaim_Thread*)atomic_load_uintptr(
+        &domain->threads
+    );
+
+    for (; thread; thread = thread->next) {
+        uint64_t seen = atomic_load_uint64(&thread->epoch);
+        if ((seen & 1) && (seen >> 1) != epoch)
+            return epoch;
+    }
+
+    if (atomic_compare_exchange_strong_uint64(
+        &domain->epoch, &epoch, epoch + 1
+    ))
+        return epoch + 1;
+    return epoch;
+}
+
+/**
+ * @brief Tries to move the global epoch on, then frees every pointer the
+ *        calling thread retired two or more epochs ago.
+ */
+static_inline void reclaim_ebr_collect(
+    Reclaim_Thread *const thread
+) {
+    uint64_t epoch = __reclaim_ebr_advance(thread->domain);
+    size_t kept = 0, i;
+
+    for (i = 0; i < thread->ebr_count; ++i) {
+        Reclaim_Retired *const r = &thread->ebr[i];
+        if (r->epoch + 2 <= epoch)
+            r->free(r->ptr);
+        else
+            thread->ebr[kept++] = *r;
+    }
+    thread->ebr_count = kept;
+}
+
+/**
+ * @brief Retires a pointer already unlinked from every shared structure, to
+ *        be freed once every read-side section which could have seen it has
+ *        ended.
+ * 
+ * @note Must not be called from inside a read-side section, which would
+ *       hold back its own batch. Pointers are collected in batches of
+ *       @c RECLAIM_BATCH before trying to advance the epoch.
+ */
+static_inline void reclaim_ebr_retire(
+    Reclaim_Thread *const thread,
+    void* ptr,
+    Reclaim_Free free_fn
+) {
+    while UNLIKELY(!__reclaim_reserve(
+        &thread->ebr, &thread->ebr_cap, thread->ebr_count
+    )) {
+        reclaim_ebr_collect(thread);
+        if (thread->ebr_count < thread->ebr_cap)
+            break;
+        thrd_yield();
+    }
+
+    thread->ebr[thread->ebr_count].ptr = ptr;
+    thread->ebr[thread->ebr_count].free = free_fn;
+    thread->ebr[thread->ebr_count].epoch = atomic_load_uint64(
+        &thread->domain->epoch
+    );
+
+    if (++thread->ebr_count % RECLAIM_BATCH == 0)
+        reclaim_ebr_collect(thread);
+}
+
+#endif /* RECLAIM_H_ */
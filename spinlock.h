@@ -0,0 +1,276 @@
+/**
+ * @file spinlock.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Busy-waiting locks for critical sections too short to be worth a
+ *        trip into the kernel.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef SPINLOCK_H_
+#define SPINLOCK_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+
+#ifndef SPIN_BACKOFF_MAX
+#   define SPIN_BACKOFF_MAX 1024
+#endif /* !SPIN_BACKOFF_MAX */
+
+#ifndef SPIN_TICKET_DELAY
+#   define SPIN_TICKET_DELAY 32
+#endif /* !SPIN_TICKET_DELAY */
+
+/* == BACKOFF =============================================================== */
+
+/**
+ * @brief Exponential backoff state for a contended spin loop.
+ */
+typedef struct Spin_Backoff {
+    uint32_t spins;
+} Spin_Backoff;
+
+/**
+ * @brief Resets a backoff to its shortest delay.
+ */
+static_inline void spin_backoff_init(
+    Spin_Backoff *const backoff
+) {
+    backoff->spins = 1;
+}
+
+/**
+ * @brief Waits out the current delay, then doubles it.
+ * 
+ * @note Delays stop growing at @c SPIN_BACKOFF_MAX calls to @c cpu_relax.
+ */
+static_inline void spin_backoff(
+    Spin_Backoff *const backoff
+) {
+    uint32_t i;
+
+    for (i = 0; i < backoff->spins; i++)
+        cpu_relax();
+    if (backoff->spins < SPIN_BACKOFF_MAX)
+        backoff->spins <<= 1;
+}
+
+/* == TEST-AND-TEST-AND-SET LOCKS =========================================== */
+
+/**
+ * @brief The smallest and fastest uncontended lock; not fair.
+ */
+typedef struct Spin_Lock {
+    atomic_uint32 locked;
+} Spin_Lock;
+
+/**
+ * @brief Initializes a lock as unlocked.
+ */
+static_inline void spin_init(
+    Spin_Lock *const lock
+) {
+    atomic_store_uint32(&lock->locked, 0);
+}
+
+/**
+ * @brief Attempts to take a lock without waiting.
+ * 
+ * @returns @c true if the lock was taken.
+ */
+static_inline bool spin_trylock(
+    Spin_Lock *const lock
+) {
+    return !atomic_load_uint32(&lock->locked) &&
+        !atomic_exchange_uint32(&lock->locked, 1);
+}
+
+/**
+ * @brief Takes a lock, spinning until it's available.
+ * 
+ * @note Waiters spin on plain loads, which stay in their own cache, and
+ *       only attempt the write once the lock looks free. Waiters that lose
+ *       that race back off exponentially.
+ */
+static_inline void spin_lock(
+    Spin_Lock *const lock
+) {
+    Spin_Backoff backoff;
+
+    if LIKELY(!atomic_exchange_uint32(&lock->locked, 1))
+        return;
+
+    spin_backoff_init(&backoff);
+    for (;;) {
+        while (atomic_load_uint32(&lock->locked))
+            cpu_relax();
+        if (!atomic_exchange_uint32(&lock->locked, 1))
+            return;
+        spin_backoff(&backoff);
+    }
+}
+
+/**
+ * @brief Releases a lock.
+ */
+static_inline void spin_unlock(
+    Spin_Lock *const lock
+) {
+    atomic_store_uint32(&lock->locked, 0);
+}
+
+/* == TICKET LOCKS ========================================================== */
+
+/**
+ * @brief A first-come first-served lock.
+ */
+typedef struct Spin_Ticket {
+    atomic_uint32 next, owner;
+} Spin_Ticket;
+
+/**
+ * @brief Initializes a ticket lock as unlocked.
+ */
+static_inline void spin_ticket_init(
+    Spin_Ticket *const lock
+) {
+    atomic_store_uint32(&lock->next, 0);
+    atomic_store_uint32(&lock->owner, 0);
+}
+
+/**
+ * @brief Attempts to take a ticket lock without waiting.
+ * 
+ * @returns @c true if the lock was taken.
+ */
+static_inline bool spin_ticket_trylock(
+    Spin_Ticket *const lock
+) {
+    uint32_t ticket = atomic_load_uint32(&lock->owner);
+    return atomic_compare_exchange_strong_uint32(
+        &lock->next, &ticket, ticket + 1
+    );
+}
+
+/**
+ * @brief Takes a ticket lock, waiting behind every earlier caller.
+ * 
+ * @note Waiters pause for @c SPIN_TICKET_DELAY relaxes per thread ahead of
+ *       them between checks, so the holder's release isn't slowed by reads.
+ */
+static_inline void spin_ticket_lock(
+    Spin_Ticket *const lock
+) {
+    uint32_t const ticket = atomic_fetch_add_uint32(&lock->next, 1);
+    uint32_t owner;
+
+    while ((owner = atomic_load_uint32(&lock->owner)) != ticket) {
+        uint32_t i = (ticket - owner) * SPIN_TICKET_DELAY;
+        while (i--)
+            cpu_relax();
+    }
+}
+
+/**
+ * @brief Releases a ticket lock to the next waiter.
+ */
+static_inline void spin_ticket_unlock(
+    Spin_Ticket *const lock
+) {
+    atomic_fetch_add_uint32(&lock->owner, 1);
+}
+
+/* == MCS QUEUE LOCKS ======================================================= */
+
+/**
+ * @brief A waiter's place in an MCS lock's queue.
+ * 
+ * @note Each thread passes its own node to lock and the same node to
+ *       unlock; it must stay alive in between, and is usually on the stack.
+ */
+typedef struct Spin_Mcs_Node {
+    atomic_uintptr next;
+    atomic_uint32 locked;
+} Spin_Mcs_Node;
+
+/**
+ * @brief A fair lock where each waiter spins on its own node.
+ * 
+ * @note Only one cache line transfer per handoff no matter how many threads
+ *       are waiting, at the price of two atomic writes to take the lock.
+ */
+typedef struct Spin_Mcs {
+    atomic_uintptr tail;
+} Spin_Mcs;
+
+/**
+ * @brief Initializes an MCS lock as unlocked.
+ */
+static_inline void spin_mcs_init(
+    Spin_Mcs *const lock
+) {
+    atomic_store_uintptr(&lock->tail, 0);
+}
+
+/**
+ * @brief Attempts to take an MCS lock without waiting.
+ * 
+ * @returns @c true if the lock was taken.
+ */
+static_inline bool spin_mcs_trylock(
+    Spin_Mcs *const lock,
+    Spin_Mcs_Node *const node
+) {
+    uintptr_t tail = 0;
+
+    atomic_store_uintptr(&node->next, 0);
+    return atomic_compare_exchange_strong_uintptr(
+        &lock->tail, &tail, (uintptr_t)node
+    );
+}
+
+/**
+ * @brief Takes an MCS lock, queueing @e node behind earlier callers.
+ */
+static_inline void spin_mcs_lock(
+    Spin_Mcs *const lock,
+    Spin_Mcs_Node *const node
+) {
+    Spin_Mcs_Node* prev;
+
+    atomic_store_uintptr(&node->next, 0);
+    atomic_store_uint32(&node->locked, 1);
+    prev = (Spin_Mcs_Node*)atomic_exchange_uintptr(
+        &lock->tail, (uintptr_t)node
+    );
+    if (prev) {
+        atomic_store_uintptr(&prev->next, (uintptr_t)node);
+        while (atomic_load_uint32(&node->locked))
+            cpu_relax();
+    }
+}
+
+/**
+ * @brief Releases an MCS lock to the thread queued behind @e node.
+ */
+static_inline void spin_mcs_unlock(
+    Spin_Mcs *const lock,
+    Spin_Mcs_Node *const node
+) {
+    uintptr_t next = atomic_load_uintptr(&node->next);
+
+    if (!next) {
+        uintptr_t tail = (uintptr_t)node;
+        if (atomic_compare_exchange_strong_uintptr(&lock->tail, &tail, 0))
+            return;
+
+        /* a successor swapped itself in but hasn't linked to us yet */
+        while (!(next = atomic_load_uintptr(&node->next)))
+            cpu_relax();
+    }
+    atomic_store_uint32(&((Spin_Mcs_Node*)next)->locked, 0);
+}
+
+#endif /* SPINLOCK_H_ */
@@ -0,0 +1,930 @@
+/**
+ * @file stream.h
+ * @author Simon Bolivar
+ * @date 18 Oct 2026
+ * 
+ * @brief Zero-copy readers over chains of reference counted buffers.
+ * 
+ * @copyright LGPL-3.0
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include "macrodefs.h"
+#include "atomics.h"
+#include "coro.h"
+#if CPP_PREREQ(1L)
+#   include <cstring>
+#else
+#   include <string.h>
+#endif
+
+/* == SEGMENTS ============================================================== */
+
+/**
+ * @brief A contiguous run of bytes.
+ * 
+ * @note Laid out like POSIX @c struct @c iovec, so arrays of spans can be
+ *       passed straight to @c readv and @c writev.
+ */
+typedef struct Stream_Span {
+    void* iov_base;
+    size_t iov_len;
+} Stream_Span;
+
+typedef struct Stream_Segment Stream_Segment;
+
+/**
+ * @brief Function called once the last reference to a segment is dropped.
+ */
+typedef void (CDECL* Stream_Release)(Stream_Segment *const seg);
+
+/**
+ * @brief A reference counted buffer which can be linked into a reader.
+ */
+struct Stream_Segment {
+    Stream_Span data;
+    Stream_Segment* next;
+    Stream_Release release;
+    atomic_uint32 refs;
+};
+
+/**
+ * @brief Initializes a segment holding a single reference.
+ * 
+ * @param[out] seg     The segment to initialize.
+ * @param[in]  data    The bytes the segment refers to.
+ * @param[in]  size    The number of bytes at @e data.
+ * @param[in]  release Called when the last reference is dropped; may be
+ *                     @c NULL.
+ */
+static_inline void stream_segment_init(
+    Stream_Segment *const seg,
+    void* data,
+    size_t size,
+    Stream_Release release
+) {
+    seg->data.iov_base = data;
+    seg->data.iov_len = size;
+    seg->next = NULL;
+    seg->release = release;
+    atomic_store_uint32(&seg->refs, 1);
+}
+
+/**
+ * @brief Adds a reference to a segment.
+ */
+static_inline void stream_segment_retain(
+    Stream_Segment *const seg
+) {
+    atomic_fetch_add_uint32(&seg->refs, 1);
+}
+
+/**
+ * @brief Drops a reference to a segment, releasing it if it was the last.
+ */
+static_inline void stream_segment_release(
+    Stream_Segment *const seg
+) {
+    if (atomic_fetch_sub_uint32(&seg->refs, 1) == 1 && seg->release)
+        (*seg->release)(seg);
+}
+
+/* == READER ================================================================ */
+
+/**
+ * @brief Reads bytes in order from a chain of segments.
+ * 
+ * @note @e ptr and @e end bound the unread part of the current segment, so
+ *       decoders can read from them directly while bytes are available.
+ * @note A reader isn't thread-safe, but the segments it holds may be shared
+ *       with other threads or readers.
+ */
+typedef struct Stream_Reader {
+    uint8_t const* ptr, * end;
+    Stream_Segment* head, * tail;
+    size_t rest;  /**< Bytes in the segments after @e head. */
+    bool closed;
+} Stream_Reader;
+
+/**
+ * @brief Initializes an empty reader.
+ */
+static_inline void stream_reader_init(
+    Stream_Reader *const reader
+) {
+    reader->ptr = reader->end = NULL;
+    reader->head = reader->tail = NULL;
+    reader->rest = 0;
+    reader->closed = false;
+}
+
+/**
+ * @brief Moves an exhausted reader on to its next segment.
+ * 
+ * @param[in,out] reader The reader, with no bytes left in its current
+ *                       segment.
+ * 
+ * @returns @c true if another segment was available; @c false otherwise.
+ */
+static_inline bool stream_advance(
+    Stream_Reader *const reader
+) {
+    Stream_Segment* seg = reader->head;
+
+    if (!seg || !seg->next)
+        return false;
+
+    reader->head = seg->next;
+    reader->ptr = (uint8_t const*)reader->head->data.iov_base;
+    reader->end = reader->ptr + reader->head->data.iov_len;
+    reader->rest -= reader->head->data.iov_len;
+    stream_segment_release(seg);
+    return true;
+}
+
+/**
+ * @brief Appends a segment to a reader.
+ * 
+ * @param[in,out] reader The reader to append to.
+ * @param[in]     seg    The segment; the caller's reference passes to the
+ *                       reader.
+ */
+static_inline void stream_reader_push(
+    Stream_Reader *const reader,
+    Stream_Segment *const seg
+) {
+    seg->next = NULL;
+    if (reader->tail) {
+        reader->tail->next = seg;
+        reader->rest += seg->data.iov_len;
+    } else {
+        reader->head = seg;
+        reader->ptr = (uint8_t const*)seg->data.iov_base;
+        reader->end = reader->ptr + seg->data.iov_len;
+    }
+    reader->tail = seg;
+
+    while (reader->ptr == reader->end && stream_advance(reader));
+}
+
+/**
+ * @brief Marks that no more segments will be pushed.
+ */
+static_inline void stream_reader_close(
+    Stream_Reader *const reader
+) {
+    reader->closed = true;
+}
+
+/**
+ * @brief Drops every segment still held by a reader.
+ */
+static_inline void stream_reader_destroy(
+    Stream_Reader *const reader
+) {
+    Stream_Segment* seg = reader->head;
+
+    while (seg) {
+        Stream_Segment* next = seg->next;
+        stream_segment_release(seg);
+        seg = next;
+    }
+    stream_reader_init(reader);
+}
+
+/**
+ * @brief Gets the number of unread bytes across every segment.
+ */
+static_inline size_t stream_available(
+    Stream_Reader const *const reader
+) {
+    return (size_t)(reader->end - reader->ptr) + reader->rest;
+}
+
+/**
+ * @brief Checks whether a closed reader has been read to the end.
+ */
+static_inline bool stream_eof(
+    Stream_Reader const *const reader
+) {
+    return reader->closed && !stream_available(reader);
+}
+
+/**
+ * @brief Gets a pointer to the next @e size bytes if they're contiguous.
+ * 
+ * @param[in,out] reader The reader to peek into.
+ * @param[in]     size   The number of bytes needed.
+ * 
+ * @note This is the fast path: a decoder parses straight out of the segment
+ *       and then calls @c stream_skip.
+ * 
+ * @returns The bytes; @c NULL if they straddle a segment boundary or haven't
+ *          arrived yet.
+ */
+static_inline uint8_t const* stream_peek(
+    Stream_Reader *const reader,
+    size_t size
+) {
+    while (reader->ptr == reader->end && stream_advance(reader));
+    return (size_t)(reader->end - reader->ptr) >= size ? reader->ptr : NULL;
+}
+
+/**
+ * @brief Consumes bytes, releasing segments which are passed over.
+ * 
+ * @returns The number of bytes skipped, less than @e size only if fewer
+ *          were available.
+ */
+static_inline size_t stream_skip(
+    Stream_Reader *const reader,
+    size_t size
+) {
+    size_t done = 0;
+
+    for (;;) {
+        size_t n = MIN(size - done, (size_t)(reader->end - reader->ptr));
+        reader->ptr += n;
+        done += n;
+        if (done == size || !stream_advance(reader))
+            return done;
+    }
+}
+
+/**
+ * @brief Copies bytes out of the reader, across segment boundaries.
+ * 
+ * @returns The number of bytes copied, less than @e size only if fewer were
+ *          available.
+ */
+static_inline size_t stream_read(
+    Stream_Reader *const reader,
+    void* dst,
+    size_t size
+) {
+    size_t done = 0;
+
+    for (;;) {
+        size_t n = MIN(size - done, (size_t)(reader->end - reader->ptr));
+        if (n)
+            memcpy((uint8_t*)dst + done, reader->ptr, n);
+        reader->ptr += n;
+        done += n;
+        if (done == size || !stream_advance(reader))
+            return done;
+    }
+}
+
+/**
+ * @brief Describes the unread bytes as an iovec-compatible array.
+ * 
+ * @param[in]  reader The reader to describe.
+ * @param[out] spans  Where to write the spans.
+ * @param[in]  count  The capacity of @e spans.
+ * 
+ * @returns The number of spans written.
+ */
+static_inline size_t stream_gather(
+    Stream_Reader const *const reader,
+    Stream_Span* spans,
+    size_t count
+) {
+    Stream_Segment const* seg;
+    size_t n = 0;
+
+    if (!count || !reader->head)
+        return 0;
+
+    spans[n].iov_base = (void*)reader->ptr;
+    spans[n++].iov_len = (size_t)(reader->end - reader->ptr);
+    for (seg = reader->head->next; seg && n < count; seg = seg->next)
+        spans[n++] = seg->data;
+    return n;
+}
+
+/* == COROUTINE HELPERS ===================================================== */
+
+/**
+ * @brief Reads one byte inside a stackless coroutine, yielding @e value
+ *        whenever the reader runs dry.
+ * 
+ * @param reader The @c Stream_Reader to read from.
+ * @param c      An @c int lvalue receiving the byte, or -1 at end of stream.
+ * @param value  The value to yield while waiting for more data.
+ * 
+ * @note Only the segment boundary takes the slow path; otherwise this is a
+ *       compare and a load.
+ */
+#define STREAM_GETC(reader, c, value) do { \
+    while UNLIKELY((reader)->ptr == (reader)->end) { \
+        if (stream_advance(reader)) \
+            continue; \
+        if ((reader)->closed) \
+            break; \
+        CORO_YIELD(value); \
+    } \
+    (c) = (reader)->ptr != (reader)->end ? *(reader)->ptr++ : -1; \
+} while (0)
+
+/**
+ * @brief Waits inside a stackless coroutine until @e size bytes are
+ *        available or the reader is closed, yielding @e value meanwhile.
+ */
+#define STREAM_NEED(reader, size, value) do { \
+    while (stream_available(reader) < (size) && !(reader)->closed) \
+        CORO_YIELD(value); \
+} while (0)
+
+/* == VARINTS =============================================================== */
+
+#if defined(__AVX2__)
+#   include <immintrin.h>
+#elif defined(__SSE2__)
+#   include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#   include <arm_neon.h>
+#endif
+
+/**
+ * @brief State of a LEB128 value being decoded across yields; keep it in the
+ *        coroutine's frame.
+ */
+typedef struct Stream_LebState {
+    uint32_t acc;
+    uint32_t shift;
+} Stream_LebState;
+
+#if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+/* decodes the complete varints in a 16 byte chunk, given its continuation
+ * bits, reading up to 8 bytes past the chunk; returns the bytes consumed */
+static_inline unsigned __stream_leb_chunk(
+    uint8_t const* p,
+    unsigned mask,
+    uint32_t* out,
+    size_t* n
+) {
+    unsigned ends = ~mask & 0xffff, pos = 0;
+
+    while (ends >> pos) {
+        unsigned len = CTZ32(ends >> pos) + 1;
+        uint64_t x;
+
+        if (len > 5)
+            break;
+
+        /* gather the 7-bit groups of all bytes at once */
+        memcpy(&x, p + pos, sizeof(x));
+        x = le64toh(x);
+        x &= (UINT64_C(1) << (8 * len)) - 1;
+        out[(*n)++] = (uint32_t)(
+            (x & 0x7f) |
+            ((x >> 1) & UINT64_C(0x3f80)) |
+            ((x >> 2) & UINT64_C(0x1fc000)) |
+            ((x >> 3) & UINT64_C(0xfe00000)) |
+            ((x >> 4) & UINT64_C(0xf0000000))
+        );
+        pos += len;
+    }
+    return pos;
+}
+#endif
+
+/**
+ * @brief Decodes as many unsigned 32-bit LEB128 values as possible from a
+ *        contiguous buffer.
+ * 
+ * @param[in,out] src   Start of the input; moved past every decoded value.
+ * @param[in]     end   End of the input.
+ * @param[out]    out   Where to store decoded values.
+ * @param[in]     count The capacity of @e out.
+ * 
+ * @note Blocks of 16 bytes (32 with AVX2) are classified with SSE2 or NEON.
+ *       A block of single byte values is widened in one go, and other blocks
+ *       are split at the terminating bytes found in the continuation mask
+ *       instead of testing each byte.
+ * @note Decoding stops before a value which runs past @e end or is longer
+ *       than 5 bytes, so it can be finished by @c STREAM_GET_LEB_U32.
+ * 
+ * @returns The number of values decoded.
+ */
+static_inline size_t stream_leb_u32_decode(
+    uint8_t const** src,
+    uint8_t const* end,
+    uint32_t* out,
+    size_t count
+) {
+    uint8_t const* p = *src;
+    size_t n = 0;
+
+#if defined(__AVX2__)
+    while (count - n >= 32 && end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((__m256i const*)p);
+        if (_mm256_movemask_epi8(v))
+            break;
+
+        _mm256_storeu_si256((__m256i*)(out + n),
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)p)));
+        _mm256_storeu_si256((__m256i*)(out + n + 8),
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(p + 8))));
+        _mm256_storeu_si256((__m256i*)(out + n + 16),
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(p + 16))));
+        _mm256_storeu_si256((__m256i*)(out + n + 24),
+            _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const*)(p + 24))));
+        n += 32;
+        p += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    while (count - n >= 16 && end - p >= 24) {
+        __m128i v = _mm_loadu_si128((__m128i const*)p);
+        unsigned mask = (unsigned)_mm_movemask_epi8(v);
+
+        if (!mask) {
+            __m128i z = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(v, z), hi = _mm_unpackhi_epi8(v, z);
+            __m128i* dst = (__m128i*)(out + n);
+            _mm_storeu_si128(dst, _mm_unpacklo_epi16(lo, z));
+            _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, z));
+            _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, z));
+            _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, z));
+            n += 16;
+            p += 16;
+        } else {
+            unsigned used = __stream_leb_chunk(p, mask, out, &n);
+            if (!used)
+                break;
+            p += used;
+        }
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    static uint8_t const weights[16] = {
+        1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128
+    };
+    uint8x16_t const w = vld1q_u8(weights);
+
+    while (count - n >= 16 && end - p >= 24) {
+        uint8x16_t v = vld1q_u8(p);
+        uint8x16_t bits = vandq_u8(
+            vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(v), 7)), w
+        );
+        unsigned mask = (unsigned)vaddv_u8(vget_low_u8(bits)) |
+            ((unsigned)vaddv_u8(vget_high_u8(bits)) << 8);
+
+        if (!mask) {
+            uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+            uint16x8_t hi = vmovl_high_u8(v);
+            vst1q_u32(out + n, vmovl_u16(vget_low_u16(lo)));
+            vst1q_u32(out + n + 4, vmovl_high_u16(lo));
+            vst1q_u32(out + n + 8, vmovl_u16(vget_low_u16(hi)));
+            vst1q_u32(out + n + 12, vmovl_high_u16(hi));
+            n += 16;
+            p += 16;
+        } else {
+            unsigned used = __stream_leb_chunk(p, mask, out, &n);
+            if (!used)
+                break;
+            p += used;
+        }
+    }
+#endif
+
+    while (n < count && p < end) {
+        uint8_t const* q = p;
+        uint32_t v = 0;
+        unsigned shift = 0;
+
+        for (;;) {
+            if (q == end || shift == 35) {
+                *src = p;
+                return n;
+            }
+            v |= (uint32_t)(*q & 0x7f) << shift;
+            shift += 7;
+            if (!(*q++ & 0x80))
+                break;
+        }
+        out[n++] = v;
+        p = q;
+    }
+
+    *src = p;
+    return n;
+}
+
+/**
+ * @brief Decodes as many LEB128 values as the reader's current segments hold
+ *        in full.
+ * 
+ * @returns The number of values decoded; fewer than @e count means the next
+ *          value straddles a segment boundary or hasn't arrived.
+ */
+static_inline size_t stream_leb_u32_bulk(
+    Stream_Reader *const reader,
+    uint32_t* out,
+    size_t count
+) {
+    size_t n = 0;
+
+    for (;;) {
+        n += stream_leb_u32_decode(
+            &reader->ptr, reader->end, out + n, count - n
+        );
+        if (n == count || reader->ptr != reader->end)
+            return n;
+        if (!stream_advance(reader))
+            return n;
+    }
+}
+
+/**
+ * @brief Decodes one LEB128 value inside a stackless coroutine, one byte at
+ *        a time, yielding @e value whenever the reader runs dry.
+ * 
+ * @param reader The @c Stream_Reader to read from.
+ * @param out    A @c uint32_t lvalue receiving the value.
+ * @param state  A @c Stream_LebState lvalue kept in the coroutine's frame.
+ * @param value  The value to yield while waiting for more data.
+ * 
+ * @note Meant for the value straddling a segment boundary after
+ *       @c stream_leb_u32_bulk stops. At end of stream @e out holds whatever
+ *       was decoded so far.
+ */
+#define STREAM_GET_LEB_U32(reader, out, state, value) do { \
+    int _leb_c; \
+    (state).acc = 0; \
+    (state).shift = 0; \
+    do { \
+        STREAM_GETC(reader, _leb_c, value); \
+        if (_leb_c < 0) \
+            break; \
+        (state).acc |= (uint32_t)(_leb_c & 0x7f) << (state).shift; \
+        (state).shift += 7; \
+    } while ((_leb_c & 0x80) && (state).shift < 35); \
+    (out) = (state).acc; \
+} while (0)
+
+/* == UTF-8 VALIDATION ====================================================== */
+
+#if !defined(__AVX2__) && defined(__SSSE3__)
+#   include <tmmintrin.h>
+#endif
+
+/**
+ * @brief State of a UTF-8 validation left mid code point by the end of a
+ *        chunk.
+ */
+typedef struct Stream_Utf8State {
+    uint8_t need;   /**< Continuation bytes still expected. */
+    uint8_t lo;     /**< Smallest byte allowed next. */
+    uint8_t hi;     /**< Largest byte allowed next. */
+} Stream_Utf8State;
+
+/**
+ * @brief Initializes a UTF-8 validation state at a code point boundary.
+ */
+static_inline void stream_utf8_init(
+    Stream_Utf8State *const state
+) {
+    state->need = 0;
+    state->lo = 0x80;
+    state->hi = 0xbf;
+}
+
+/*
+ * Block kernels use the lookup method of Keiser & Lemire: three nibble
+ * lookups (high and low nibble of the previous byte, high nibble of the
+ * current one) give a set of error classes per byte which must all agree,
+ * and the third and fourth bytes of long sequences are checked apart. A
+ * kernel starts at a code point boundary and stops less than a block from
+ * the end, backing up to the lead byte of a code point the block cut short.
+ */
+#if defined(__AVX2__) || defined(__SSSE3__) || \
+    (defined(__aarch64__) && defined(__ARM_NEON))
+static_inline uint8_t const* __stream_utf8_rewind(uint8_t const* q) {
+    unsigned i;
+
+    for (i = 1; i <= 3; ++i) {
+        unsigned c = q[-(int)i];
+        if ((c & 0xc0) != 0x80) {
+            if (c >= 0xc0 && i < (c >= 0xf0 ? 4u : c >= 0xe0 ? 3u : 2u))
+                return q - i;
+            break;
+        }
+    }
+    return q;
+}
+
+#   define __STREAM_UTF8_TABLES \
+    static uint8_t const tables[4][16] = { \
+        /* by high nibble of the previous byte */ \
+        { 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, 0x02, \
+          0x80, 0x80, 0x80, 0x80, 0x21, 0x01, 0x15, 0x49 }, \
+        /* by low nibble of the previous byte */ \
+        { 0xe7, 0xa3, 0x83, 0x83, 0x8b, 0xcb, 0xcb, 0xcb, \
+          0xcb, 0xcb, 0xcb, 0xcb, 0xcb, 0xdb, 0xcb, 0xcb }, \
+        /* by high nibble of the current byte */ \
+        { 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, \
+          0xe6, 0xae, 0xba, 0xba, 0x01, 0x01, 0x01, 0x01 }, \
+        /* largest bytes which don't begin a sequence cut off at the end */ \
+        { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, \
+          0xff, 0xff, 0xff, 0xff, 0xff, 0xef, 0xdf, 0xbf } \
+    }
+#endif
+
+#if defined(__AVX2__)
+#   define __STREAM_UTF8_BLOCK 32
+#   define __STREAM_UTF8_PREV(in, prev, n) _mm256_alignr_epi8( \
+        in, _mm256_permute2x128_si256(prev, in, 0x21), 16 - (n) \
+    )
+static_inline uint8_t const* __stream_utf8_blocks(
+    uint8_t const* p,
+    uint8_t const* end
+) {
+    __STREAM_UTF8_TABLES;
+    __m256i const t1h = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((__m128i const*)tables[0])
+    );
+    __m256i const t1l = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((__m128i const*)tables[1])
+    );
+    __m256i const t2h = _mm256_broadcastsi128_si256(
+        _mm_loadu_si128((__m128i const*)tables[2])
+    );
+    __m256i const max = _mm256_setr_m128i(
+        _mm_set1_epi8(-1), _mm_loadu_si128((__m128i const*)tables[3])
+    );
+    __m256i const nibble = _mm256_set1_epi8(0x0f);
+    __m256i prev = _mm256_setzero_si256(), incomplete = prev, err = prev;
+
+    do {
+        __m256i in = _mm256_loadu_si256((__m256i const*)p);
+
+        if (!_mm256_movemask_epi8(in)) {
+            err = _mm256_or_si256(err, incomplete);
+            incomplete = _mm256_setzero_si256();
+        } else {
+            __m256i prev1 = __STREAM_UTF8_PREV(in, prev, 1);
+            __m256i classes = _mm256_and_si256(
+                _mm256_and_si256(
+                    _mm256_shuffle_epi8(t1h, _mm256_and_si256(
+                        _mm256_srli_epi16(prev1, 4), nibble
+                    )),
+                    _mm256_shuffle_epi8(t1l, _mm256_and_si256(prev1, nibble))
+                ),
+                _mm256_shuffle_epi8(t2h, _mm256_and_si256(
+                    _mm256_srli_epi16(in, 4), nibble
+                ))
+            );
+            __m256i must23 = _mm256_or_si256(
+                _mm256_subs_epu8(
+                    __STREAM_UTF8_PREV(in, prev, 2), _mm256_set1_epi8(0x60)
+                ),
+                _mm256_subs_epu8(
+                    __STREAM_UTF8_PREV(in, prev, 3), _mm256_set1_epi8(0x70)
+                )
+            );
+            err = _mm256_or_si256(err, _mm256_xor_si256(classes,
+                _mm256_and_si256(must23, _mm256_set1_epi8((char)0x80))
+            ));
+            incomplete = _mm256_subs_epu8(in, max);
+        }
+        prev = in;
+        p += 32;
+    } while (end - p >= 32);
+
+    if (!_mm256_testz_si256(err, err))
+        return NULL;
+    return __stream_utf8_rewind(p);
+}
+#   undef __STREAM_UTF8_PREV
+#elif defined(__SSSE3__)
+#   define __STREAM_UTF8_BLOCK 16
+static_inline uint8_t const* __stream_utf8_blocks(
+    uint8_t const* p,
+    uint8_t const* end
+) {
+    __STREAM_UTF8_TABLES;
+    __m128i const t1h = _mm_loadu_si128((__m128i const*)tables[0]);
+    __m128i const t1l = _mm_loadu_si128((__m128i const*)tables[1]);
+    __m128i const t2h = _mm_loadu_si128((__m128i const*)tables[2]);
+    __m128i const max = _mm_loadu_si128((__m128i const*)tables[3]);
+    __m128i const nibble = _mm_set1_epi8(0x0f);
+    __m128i prev = _mm_setzero_si128(), incomplete = prev, err = prev;
+
+    do {
+        __m128i in = _mm_loadu_si128((__m128i const*)p);
+
+        if (!_mm_movemask_epi8(in)) {
+            err = _mm_or_si128(err, incomplete);
+            incomplete = _mm_setzero_si128();
+        } else {
+            __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+            __m128i classes = _mm_and_si128(
+                _mm_and_si128(
+                    _mm_shuffle_epi8(t1h, _mm_and_si128(
+                        _mm_srli_epi16(prev1, 4), nibble
+                    )),
+                    _mm_shuffle_epi8(t1l, _mm_and_si128(prev1, nibble))
+                ),
+                _mm_shuffle_epi8(t2h, _mm_and_si128(
+                    _mm_srli_epi16(in, 4), nibble
+                ))
+            );
+            __m128i must23 = _mm_or_si128(
+                _mm_subs_epu8(
+                    _mm_alignr_epi8(in, prev, 14), _mm_set1_epi8(0x60)
+                ),
+                _mm_subs_epu8(
+                    _mm_alignr_epi8(in, prev, 13), _mm_set1_epi8(0x70)
+                )
+            );
+            err = _mm_or_si128(err, _mm_xor_si128(classes,
+                _mm_and_si128(must23, _mm_set1_epi8((char)0x80))
+            ));
+            incomplete = _mm_subs_epu8(in, max);
+        }
+        prev = in;
+        p += 16;
+    } while (end - p >= 16);
+
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(err, _mm_setzero_si128())) != 0xffff)
+        return NULL;
+    return __stream_utf8_rewind(p);
+}
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#   define __STREAM_UTF8_BLOCK 16
+static_inline uint8_t const* __stream_utf8_blocks(
+    uint8_t const* p,
+    uint8_t const* end
+) {
+    __STREAM_UTF8_TABLES;
+    uint8x16_t const t1h = vld1q_u8(tables[0]);
+    uint8x16_t const t1l = vld1q_u8(tables[1]);
+    uint8x16_t const t2h = vld1q_u8(tables[2]);
+    uint8x16_t const max = vld1q_u8(tables[3]);
+    uint8x16_t const nibble = vdupq_n_u8(0x0f);
+    uint8x16_t prev = vdupq_n_u8(0), incomplete = prev, err = prev;
+
+    do {
+        uint8x16_t in = vld1q_u8(p);
+
+        if (vmaxvq_u8(in) < 0x80) {
+            err = vorrq_u8(err, incomplete);
+            incomplete = vdupq_n_u8(0);
+        } else {
+            uint8x16_t prev1 = vextq_u8(prev, in, 15);
+            uint8x16_t classes = vandq_u8(
+                vandq_u8(
+                    vqtbl1q_u8(t1h, vshrq_n_u8(prev1, 4)),
+                    vqtbl1q_u8(t1l, vandq_u8(prev1, nibble))
+                ),
+                vqtbl1q_u8(t2h, vshrq_n_u8(in, 4))
+            );
+            uint8x16_t must23 = vorrq_u8(
+                vqsubq_u8(vextq_u8(prev, in, 14), vdupq_n_u8(0x60)),
+                vqsubq_u8(vextq_u8(prev, in, 13), vdupq_n_u8(0x70))
+            );
+            err = vorrq_u8(err, veorq_u8(classes,
+                vandq_u8(must23, vdupq_n_u8(0x80))
+            ));
+            incomplete = vqsubq_u8(in, max);
+        }
+        prev = in;
+        p += 16;
+    } while (end - p >= 16);
+
+    if (vmaxvq_u8(err))
+        return NULL;
+    return __stream_utf8_rewind(p);
+}
+#endif
+#undef __STREAM_UTF8_TABLES
+
+/**
+ * @brief Validates the next chunk of a UTF-8 stream.
+ * 
+ * @param[in,out] state Where the previous chunk left off; updated to where
+ *                      this one does.
+ * @param[in]     data  The chunk.
+ * @param[in]     size  The number of bytes at @e data.
+ * 
+ * @note Chunks may split a code point anywhere; only the few bytes of the
+ *       split code point are checked one at a time, and nothing is scanned
+ *       twice.
+ * @note Runs of 32 or 16 bytes are checked together with AVX2, SSSE3 or
+ *       NEON. Otherwise runs of ASCII are skipped 8 bytes at a time.
+ * 
+ * @returns @c false if the chunk makes the stream invalid; @c true
+ *          otherwise.
+ */
+static_inline bool stream_utf8_check(
+    Stream_Utf8State *const state,
+    void const* data,
+    size_t size
+) {
+    uint8_t const* p = (uint8_t const*)data;
+    uint8_t const* end = p + size;
+    unsigned need = state->need, lo = state->lo, hi = state->hi;
+
+    while (p < end) {
+        unsigned c;
+
+        if (need) {
+            c = *p++;
+            if (c < lo || c > hi)
+                return false;
+            --need;
+            lo = 0x80;
+            hi = 0xbf;
+            continue;
+        }
+
+#ifdef __STREAM_UTF8_BLOCK
+        if (end - p >= __STREAM_UTF8_BLOCK) {
+            p = __stream_utf8_blocks(p, end);
+            if (!p)
+                return false;
+        }
+#endif
+        while (end - p >= 8) {
+            uint64_t word;
+            memcpy(&word, p, sizeof(word));
+            if (word & UINT64_C(0x8080808080808080))
+                break;
+            p += 8;
+        }
+        if (p == end)
+            break;
+
+        c = *p++;
+        if (c < 0x80)
+            continue;
+        else if (c < 0xc2)
+            return false;
+        else if (c < 0xe0)
+            need = 1;
+        else if (c < 0xf0) {
+            need = 2;
+            lo = c == 0xe0 ? 0xa0 : 0x80;
+            hi = c == 0xed ? 0x9f : 0xbf;
+        } else if (c < 0xf5) {
+            need = 3;
+            lo = c == 0xf0 ? 0x90 : 0x80;
+            hi = c == 0xf4 ? 0x8f : 0xbf;
+        } else
+            return false;
+    }
+
+    state->need = (uint8_t)need;
+    state->lo = (uint8_t)lo;
+    state->hi = (uint8_t)hi;
+    return true;
+}
+
+/**
+ * @brief Checks whether a validated stream ended on a code point boundary.
+ */
+static_inline bool stream_utf8_complete(
+    Stream_Utf8State const *const state
+) {
+    return !state->need;
+}
+
+CORO_DECLARE(int, stream_utf8_validate, {
+    Stream_Utf8State state;
+});
+/**
+ * @brief Stackless coroutine validating a UTF-8 stream fed one chunk per
+ *        call.
+ * 
+ * @param[in] coro A stack of at least 2 @c Coro_Stack words; zeroed before
+ *                 the first chunk.
+ * @param[in] data The next chunk.
+ * @param[in] size The number of bytes at @e data; 0 ends the stream.
+ * 
+ * @note The partial code point carried between chunks lives in the frame,
+ *       so validation pauses at any chunk boundary and never re-scans.
+ * 
+ * @returns -1 while waiting for the next chunk; 1 once the stream ended
+ *          valid; 0 as soon as it's found invalid.
+ */
+static_inline int stream_utf8_validate(
+    Coro_Stack* coro,
+    void const* data,
+    size_t size
+) {
+    int result = 0;
+    CORO_BEGIN(stream_utf8_validate) {
+        stream_utf8_init(&frame->state);
+        while (size) {
+            if (!stream_utf8_check(&frame->state, data, size))
+                break;
+            CORO_YIELD(-1);
+        }
+        result = !size && stream_utf8_complete(&frame->state);
+    } CORO_END(result);
+}
+
+#endif /* STREAM_H_ */
@@ -346,6 +346,48 @@ THRD_API int THRD_CALL cnd_reltimedwait_np(
 ) NO_EXCEPT;
 THRD_API unsigned THRD_CALL thrd_hardware_concurrency(void);
 
+/* -- atomic wait & notify -------------------------------------------------- */
+
+#include "atomics.h"
+
+/**
+ * @brief Blocks until the value of an atomic is no longer @e old.
+ * 
+ * @note Spins for @c THRD_WAIT_SPINS checks before sleeping. Sleeps on a
+ *       futex on Linux, or otherwise on one of a fixed table of condition
+ *       variables hashed by address. May wake up spuriously; recheck the
+ *       value after returning.
+ */
+THRD_API void THRD_CALL atomic_wait_uint32(
+    atomic_uint32 volatile* a,
+    uint32_t old
+) NO_EXCEPT;
+THRD_API void THRD_CALL atomic_wait_uint64(
+    atomic_uint64 volatile* a,
+    uint64_t old
+) NO_EXCEPT;
+
+/**
+ * @brief Wakes threads blocked in @c atomic_wait on @e a after its value was
+ *        changed.
+ * 
+ * @note Costs only a load when nobody is waiting near @e a. Where waiters
+ *       share a hashed slot (64-bit values, or without futexes),
+ *       @c notify_one wakes all of them.
+ */
+THRD_API void THRD_CALL atomic_notify_one_uint32(
+    atomic_uint32 volatile* a
+) NO_EXCEPT;
+THRD_API void THRD_CALL atomic_notify_all_uint32(
+    atomic_uint32 volatile* a
+) NO_EXCEPT;
+THRD_API void THRD_CALL atomic_notify_one_uint64(
+    atomic_uint64 volatile* a
+) NO_EXCEPT;
+THRD_API void THRD_CALL atomic_notify_all_uint64(
+    atomic_uint64 volatile* a
+) NO_EXCEPT;
+
 /* == IMPLEMENTATION ======================================================== */
 
 #ifdef THREAD_IMPLEMENTATION
@@ -2038,7 +2080,7 @@ THRD_API unsigned THRD_CALL thrd_hardware_concurrency(void);
         )) {
             return thrd_error;
         } else if (!duration) {
-            return mtx_lock(cond, mutex);
+            return mtx_lock(mutex);
         } else {
             struct timespec absolute_time = _get_time();
             absolute_time.tv_sec += duration->tv_sec;
@@ -2495,29 +2537,6 @@ THRD_API unsigned THRD_CALL thrd_hardware_concurrency(void);
 /* -- call_once ------------------------------------------------------------- */
 
 #ifdef _NO_CALLONCE_DEFINITION
-#   if GCC_PREREQ(1) || CLANG_PREREQ(1)
-#       if defined(__i386__) || defined(__x86_64__)
-#           define __THRD_PAUSE() __asm__ __volatile__("pause\n")
-#       elif (defined(__arm__) && __ARM_ARCH__ >= 7) || defined(__aarch64__)
-#           define __THRD_PAUSE() __asm__ __volatile__("yield" ::: "memory")
-#       elif (defined(__powerpc__) || defined(__powerpc64__))
-#           define __THRD_PAUSE() __asm__ __volatile__("or 27,27,27")
-#       endif
-#   elif MSVC_PREREQ(1)
-#       include <intrin.h>
-#       if defined(__i386__)
-#           define __THRD_PAUSE() _mm_pause()
-#       elif defined(__arm__) || defined(__aarch64__)
-#           define __THRD_PAUSE() __yield()
-#       endif
-#   elif defined(__WATCOMC__) && defined(__i386__)
-        extern _inline void __THRD_PAUSE(void);
-#       pragma aux __THRD_PAUSE = "db 0f3h,90h"
-#       define __THRD_PAUSE __THRD_PAUSE
-#   endif
-#   ifndef __THRD_PAUSE
-#       define __THRD_PAUSE()
-#   endif
 
     void call_once(once_flag* flag, void (*func)(void)) {
         if (flag && func && atomic_flag_test_and_set(flag))
@@ -2526,6 +2545,152 @@ THRD_API unsigned THRD_CALL thrd_hardware_concurrency(void);
 
 #endif
 
+/* -- atomic wait & notify -------------------------------------------------- */
+
+#ifndef THRD_WAIT_SPINS
+#   define THRD_WAIT_SPINS 64
+#endif
+
+#if defined(__linux__) && ( \
+    defined(_DEFAULT_SOURCE) || defined(_GNU_SOURCE) || defined(_BSD_SOURCE) \
+)
+#   include <linux/futex.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#   if defined(SYS_futex) && defined(FUTEX_WAIT_PRIVATE)
+#       define __THRD_FUTEX(addr, op, value) \
+            syscall(SYS_futex, (addr), (op), (value), NULL, NULL, 0)
+#   endif
+#endif
+
+typedef struct __thrd_wait_bucket {
+    atomic_uint32 waiters, seq;
+#ifndef __THRD_FUTEX
+    atomic_uint32 state;
+    mtx_t lock;
+    cnd_t cond;
+#endif
+} __thrd_wait_bucket;
+
+static __thrd_wait_bucket __thrd_wait_table[64];
+
+static __thrd_wait_bucket* __thrd_wait_bucket_of(void volatile* a) {
+    __thrd_wait_bucket* const bucket = &__thrd_wait_table[
+        ((uint32_t)((uintptr_t)a >> 2) * UINT32_C(0x9E3779B1)) >> 26
+    ];
+#ifndef __THRD_FUTEX
+    uint32_t state;
+    while ((state = atomic_load_uint32(&bucket->state)) != 2) {
+        if (!state && atomic_compare_exchange_strong_uint32(
+            &bucket->state, &state, 1
+        )) {
+            mtx_init(&bucket->lock, mtx_plain);
+            cnd_init(&bucket->cond);
+            atomic_store_uint32(&bucket->state, 2);
+        } else {
+            thrd_yield();
+        }
+    }
+#endif
+    return bucket;
+}
+
+/* wakes everyone sleeping on a bucket; used when addresses may collide */
+static void __thrd_wait_broadcast(__thrd_wait_bucket* bucket) {
+#ifdef __THRD_FUTEX
+    atomic_fetch_add_uint32(&bucket->seq, 1);
+    __THRD_FUTEX(&bucket->seq, FUTEX_WAKE_PRIVATE, INT_MAX);
+#else
+    mtx_lock(&bucket->lock);
+    mtx_unlock(&bucket->lock);
+    cnd_broadcast(&bucket->cond);
+#endif
+}
+
+void atomic_wait_uint32(atomic_uint32 volatile* a, uint32_t old) NO_EXCEPT {
+    __thrd_wait_bucket* bucket;
+    int spins;
+
+    for (spins = 0; spins < THRD_WAIT_SPINS; spins++) {
+        if (atomic_load_uint32(a) != old)
+            return;
+        cpu_relax();
+    }
+
+    bucket = __thrd_wait_bucket_of(a);
+    atomic_fetch_add_uint32(&bucket->waiters, 1);
+#ifdef __THRD_FUTEX
+    while (atomic_load_uint32(a) == old)
+        __THRD_FUTEX(a, FUTEX_WAIT_PRIVATE, old);
+#else
+    mtx_lock(&bucket->lock);
+    while (atomic_load_uint32(a) == old)
+        cnd_wait(&bucket->cond, &bucket->lock);
+    mtx_unlock(&bucket->lock);
+#endif
+    atomic_fetch_sub_uint32(&bucket->waiters, 1);
+}
+
+void atomic_wait_uint64(atomic_uint64 volatile* a, uint64_t old) NO_EXCEPT {
+    __thrd_wait_bucket* bucket;
+    int spins;
+
+    for (spins = 0; spins < THRD_WAIT_SPINS; spins++) {
+        if (atomic_load_uint64(a) != old)
+            return;
+        cpu_relax();
+    }
+
+    bucket = __thrd_wait_bucket_of(a);
+    atomic_fetch_add_uint32(&bucket->waiters, 1);
+#ifdef __THRD_FUTEX
+    for (;;) {
+        uint32_t const seq = atomic_load_uint32(&bucket->seq);
+        if (atomic_load_uint64(a) != old)
+            break;
+        __THRD_FUTEX(&bucket->seq, FUTEX_WAIT_PRIVATE, seq);
+    }
+#else
+    mtx_lock(&bucket->lock);
+    while (atomic_load_uint64(a) == old)
+        cnd_wait(&bucket->cond, &bucket->lock);
+    mtx_unlock(&bucket->lock);
+#endif
+    atomic_fetch_sub_uint32(&bucket->waiters, 1);
+}
+
+void atomic_notify_one_uint32(atomic_uint32 volatile* a) NO_EXCEPT {
+    __thrd_wait_bucket* const bucket = __thrd_wait_bucket_of(a);
+    if (atomic_load_uint32(&bucket->waiters)) {
+#ifdef __THRD_FUTEX
+        __THRD_FUTEX(a, FUTEX_WAKE_PRIVATE, 1);
+#else
+        __thrd_wait_broadcast(bucket);
+#endif
+    }
+}
+
+void atomic_notify_all_uint32(atomic_uint32 volatile* a) NO_EXCEPT {
+    __thrd_wait_bucket* const bucket = __thrd_wait_bucket_of(a);
+    if (atomic_load_uint32(&bucket->waiters)) {
+#ifdef __THRD_FUTEX
+        __THRD_FUTEX(a, FUTEX_WAKE_PRIVATE, INT_MAX);
+#else
+        __thrd_wait_broadcast(bucket);
+#endif
+    }
+}
+
+void atomic_notify_one_uint64(atomic_uint64 volatile* a) NO_EXCEPT {
+    atomic_notify_all_uint64(a);
+}
+
+void atomic_notify_all_uint64(atomic_uint64 volatile* a) NO_EXCEPT {
+    __thrd_wait_bucket* const bucket = __thrd_wait_bucket_of(a);
+    if (atomic_load_uint32(&bucket->waiters))
+        __thrd_wait_broadcast(bucket);
+}
+
 /* -- C++ thread::hardware_concurrency -------------------------------------- */
 
 #ifdef _GNU_SOURCE